@@ -0,0 +1,122 @@
+#version 330 core
+
+in vec2 ndc;
+
+out vec4 FragColor;
+
+layout(std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+    mat4 invViewProj;
+    vec4 cameraPos;     // xyz
+};
+
+layout(std140) uniform Palette
+{
+    vec4 palette[5];    // rgb per material
+};
+
+uniform usampler3D cells;
+uniform usampler3D bricks;
+uniform int gridSize;
+uniform int brickSize;
+
+// Entry and exit distances of a ray through an axis-aligned box
+vec2 intersectBox(vec3 ro, vec3 invDir, vec3 lo, vec3 hi)
+{
+    vec3 t0 = (lo - ro) * invDir;
+    vec3 t1 = (hi - ro) * invDir;
+    vec3 tNear = min(t0, t1);
+    vec3 tFar = max(t0, t1);
+    return vec2(max(max(tNear.x, tNear.y), tNear.z), min(min(tFar.x, tFar.y), tFar.z));
+}
+
+void main()
+{
+    // Voxel i spans [i, i + 1) in march space, so shift world space by half a cell
+    vec4 farPoint = invViewProj * vec4(ndc, 1.0, 1.0);
+    vec3 ro = cameraPos.xyz + 0.5;
+    vec3 rd = normalize(farPoint.xyz / farPoint.w - cameraPos.xyz);
+    rd = mix(rd, vec3(1e-6), equal(rd, vec3(0.0)));
+    vec3 invDir = 1.0 / rd;
+    ivec3 stepDir = ivec3(sign(rd));
+    vec3 tDelta = abs(invDir);
+
+    vec2 span = intersectBox(ro, invDir, vec3(0.0), vec3(gridSize));
+    if (span.x > span.y || span.y < 0.0) discard;
+
+    // Distance at which the ray entered the current cell, and the face it came through
+    float tCell = max(span.x, 0.0);
+    vec3 normal = vec3(0.0);
+    if (span.x > 0.0) {
+        vec3 tNear = min(-ro * invDir, (vec3(gridSize) - ro) * invDir);
+        if (tNear.x >= tNear.y && tNear.x >= tNear.z) normal.x = -float(stepDir.x);
+        else if (tNear.y >= tNear.z) normal.y = -float(stepDir.y);
+        else normal.z = -float(stepDir.z);
+    }
+
+    ivec3 cell = clamp(ivec3(floor(ro + rd * (tCell + 1e-4))), ivec3(0), ivec3(gridSize - 1));
+    vec3 tMax = (vec3(cell) + max(vec3(stepDir), 0.0) - ro) * invDir;
+
+    // A cell step moves along one axis, so no ray through the grid takes more than three per cell of edge
+    int maxSteps = 3 * gridSize;
+    for (int i = 0; i < maxSteps; ++i) {
+        if (any(lessThan(cell, ivec3(0))) || any(greaterThanEqual(cell, ivec3(gridSize)))) break;
+
+        // Skip bricks with nothing to draw in a single jump
+        ivec3 brick = cell / brickSize;
+        if (texelFetch(bricks, brick, 0).r == 0u) {
+            // The ray leaves through the face along the axis it reaches first, like a cell step
+            ivec3 lo = brick * brickSize;
+            vec3 tExit = (vec3(lo) + max(vec3(stepDir), 0.0) * float(brickSize) - ro) * invDir;
+            int axis = (tExit.x < tExit.y && tExit.x < tExit.z) ? 0 : (tExit.y < tExit.z ? 1 : 2);
+            tCell = tExit[axis];
+            ivec3 next = clamp(ivec3(floor(ro + rd * tCell)), lo, lo + brickSize - 1);
+            next[axis] = stepDir[axis] > 0 ? lo[axis] + brickSize : lo[axis] - 1;
+            normal = vec3(0.0);
+            normal[axis] = -float(stepDir[axis]);
+            cell = next;
+            tMax = (vec3(cell) + max(vec3(stepDir), 0.0) - ro) * invDir;
+            continue;
+        }
+
+        uint texel = texelFetch(cells, cell, 0).r;
+        uint m = texel & 7u;
+        bool hit = m != 0u;
+        if (hit && (texel >> 3) != 0u) {
+            // Partly filled water only occupies the bottom of its cell, up to its fill
+            float fill = float(texel >> 3) / 32.0;
+            vec2 water = intersectBox(ro, invDir, vec3(cell), vec3(cell) + vec3(1.0, fill, 1.0));
+            hit = water.x <= water.y && water.y >= tCell;
+            if (hit && water.x > tCell) {
+                tCell = water.x;
+                normal = vec3(0.0, 1.0, 0.0);
+            }
+        }
+        if (hit) {
+            // Depth of the entry point keeps the pass composable with rasterized geometry
+            vec4 clip = viewProj * vec4(ro + rd * tCell - 0.5, 1.0);
+            gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+
+            vec3 lightDir = normalize(vec3(1.0, 1.0, 1.0));
+            float diff = max(dot(normal, lightDir), 0.2);
+            FragColor = vec4(palette[m].rgb * (diff + 0.5), 1.0);
+            return;
+        }
+
+        // Step into whichever neighbour the ray reaches first
+        if (tMax.x < tMax.y && tMax.x < tMax.z) {
+            tCell = tMax.x; cell.x += stepDir.x; tMax.x += tDelta.x;
+            normal = vec3(-float(stepDir.x), 0.0, 0.0);
+        } else if (tMax.y < tMax.z) {
+            tCell = tMax.y; cell.y += stepDir.y; tMax.y += tDelta.y;
+            normal = vec3(0.0, -float(stepDir.y), 0.0);
+        } else {
+            tCell = tMax.z; cell.z += stepDir.z; tMax.z += tDelta.z;
+            normal = vec3(0.0, 0.0, -float(stepDir.z));
+        }
+    }
+    discard;
+}
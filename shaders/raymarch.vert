@@ -0,0 +1,11 @@
+#version 330 core
+
+out vec2 ndc;
+
+void main()
+{
+    // One triangle that covers the whole screen
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    ndc = corner * 2.0 - 1.0;
+    gl_Position = vec4(ndc, 0.0, 1.0);
+}
@@ -3,18 +3,31 @@
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 instancePos;
 layout(location = 2) in vec3 color;
+layout(location = 3) in vec3 scale;
+layout(location = 4) in vec3 normal;
+layout(location = 5) in uvec2 occlusion;
 
 out vec3 fragColor;
-flat out int faceID;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+layout(std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProj;
+    mat4 invViewProj;
+    vec4 cameraPos;     // xyz
+};
 
 void main()
 {
-    vec3 worldPos = instancePos + position;
-    gl_Position = projection * view * model * vec4(worldPos, 1.0);
-    fragColor = color;
-    faceID = gl_VertexID / 6;
+    vec3 worldPos = instancePos + position * scale;
+    gl_Position = viewProj * vec4(worldPos, 1.0);
+
+    // The index into the 24-vertex cube names this face corner's two occlusion bits
+    uint shade = (occlusion[gl_VertexID >> 4] >> uint((gl_VertexID & 15) * 2)) & 3u;
+
+    // Flat shading with bright lighting, darkened into occluded corners
+    vec3 lightDir = normalize(vec3(1.0, 1.0, 1.0));
+    float diff = max(dot(normal, lightDir), 0.2);
+    fragColor = color * (diff + 0.5) * (1.0 - 0.15 * float(shade));  // Added ambient light (0.5)
 }
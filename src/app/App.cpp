@@ -1,14 +1,11 @@
 #include "App.hpp"
-#include "../sim/Rules.hpp"
+#include "../render/CameraPath.hpp"
+#include "../render/FrameExporter.hpp"
+#include "../sim/Scene.hpp"
+#include <cstdlib>
 #include <iostream>
 #include <glm/glm.hpp>
-#include <random>
-
-namespace {
-    std::mt19937 rng(42);
-    std::uniform_real_distribution<float> prob(0.0f, 1.0f);
-
-}
+#include <algorithm>
 
 static App* g_app = nullptr;
 
@@ -24,6 +21,17 @@ void App::mouseButtonCallback(GLFWwindow* w, int button, int action, int mods)
         glfwGetCursorPos(w, &mx, &my);
         g_app->placeMaterial(mx, my);
     }
+
+    // Right button paints strokes while held
+    if (g_app && button == GLFW_MOUSE_BUTTON_RIGHT) {
+        g_app->painting = (action == GLFW_PRESS);
+        g_app->hasLastPaint = false;
+        if (g_app->painting) {
+            double mx, my;
+            glfwGetCursorPos(w, &mx, &my);
+            g_app->paintStroke(mx, my);
+        }
+    }
 }
 
 // Callback for cursor tracking
@@ -34,6 +42,9 @@ void App::cursorPosCallback(GLFWwindow* w, double x, double y)
         double deltaY = y - g_app->lastMouseY;
         g_app->camera->rotate((float)deltaX, (float)deltaY);
     }
+    if (g_app && g_app->painting) {
+        g_app->paintStroke(x, y);
+    }
     if (g_app) {
         g_app->lastMouseX = x;
         g_app->lastMouseY = y;
@@ -65,8 +76,9 @@ void App::framebufferSizeCallback(GLFWwindow* w, int width, int height)
 
 // App constructor and destructor
 App::App()
-    : window(nullptr), windowWidth(1200), windowHeight(800), running(false),
-      paused(false), lastMouseX(0), lastMouseY(0), mousePressed(false)
+    : window(nullptr), statsTick(0), windowWidth(1200), windowHeight(800), running(false),
+      paused(false), normalTps(20.0f), lastMouseX(0), lastMouseY(0), mousePressed(false),
+      painting(false), hasLastPaint(false), lastPaint(0.0f)
 {
     g_app = this;
 }
@@ -81,8 +93,16 @@ App::~App()
 }
 
 // Initialize simulation and rendering
-bool App::initialize()
+bool App::initialize(const std::string& scenePath, bool headless)
 {
+    // Without a display, render through a software OSMesa context on GLFW's null platform
+    bool noDisplay = headless && !std::getenv("DISPLAY") && !std::getenv("WAYLAND_DISPLAY");
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 4)
+    if (noDisplay) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#else
+    if (noDisplay) std::cerr << "No display found, and GLFW older than 3.4 has no null platform" << std::endl;
+#endif
+
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
         return false;
@@ -91,6 +111,10 @@ bool App::initialize()
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (headless) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 4)
+    if (noDisplay) glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#endif
 
     window = glfwCreateWindow(windowWidth, windowHeight, "Automata", nullptr, nullptr);
     if (!window) {
@@ -116,8 +140,7 @@ bool App::initialize()
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    // Create grid and renderer
-    grid = std::make_unique<Grid>();
+    // Create renderer and camera
     renderer = std::make_unique<Renderer>();
     camera = std::make_unique<Camera>();
 
@@ -126,58 +149,103 @@ bool App::initialize()
         return false;
     }
 
+    renderer->reshape(windowWidth, windowHeight);
     camera->setAspectRatio((float)windowWidth / (float)windowHeight);
 
-    // Water pool
-    for (int x = 5; x < 59; ++x) {
-        for (int z = 5; z < 59; ++z) {
-            for (int y = 2; y < 25; ++y) {
-                grid->set(x, y, z, Material::WATER);
-            }
-        }
+    // Saved shader edits are picked up while the simulation keeps running
+    if (!headless) {
+        shaderWatcher = std::make_unique<FileWatcher>("shaders");
+    }
+
+    // Build the grid and rules from the scene description
+    this->scenePath = scenePath;
+    if (!loadScene()) {
+        return false;
+    }
+
+    running = true;
+    paused = false;
+    return true;
+}
+
+// Render a scripted run offscreen
+bool App::exportFrames(const ExportSettings& settings)
+{
+    CameraPath path;
+    if (!settings.cameraPath.empty() && !path.load(settings.cameraPath)) {
+        return false;
+    }
+
+    FrameExporter exporter;
+    if (!exporter.initialize(settings.width, settings.height, settings.output)) {
+        return false;
     }
 
-    // Sand pile
-    for (int i = 15; i < 49; ++i) {
-        for (int j = 15; j < 49; ++j) {
-            for (int k = 35; k < 55; ++k) {
-                grid->set(i, k, j, Material::SAND);
-            }
+    renderer->setMode(settings.mode);
+    renderer->reshape(settings.width, settings.height);
+    camera->setAspectRatio((float)settings.width / (float)settings.height);
+
+    // The GPU reads back each frame while the next ticks run, and a writer thread handles the files
+    int tick = 0;
+    for (int frame = 0; frame < settings.frames; ++frame) {
+        path.apply((float)tick, *camera);
+        exporter.bind();
+        renderer->render(*grid, *camera);
+        exporter.capture();
+
+        for (int i = 0; i < settings.ticksPerFrame; ++i) {
+            update();
         }
+        tick += settings.ticksPerFrame;
     }
 
-    // GOL random
-    // for (int x = 24; x < 40; ++x) {
-    //     for (int y = 32; y < 48; ++y) {
-    //         for (int z = 24; z < 40; ++z) {
-    //             if (prob(rng) < 0.38f) {  // ← IMPORTANT
-    //                 grid->set(x, y, z, Material::GOL);
-    //             }
-    //         }
-    //     }
-    // }
-
-    // // GOL cube
-    // for (int x = 26; x < 38; ++x)
-    // for (int y = 34; y < 46; ++y)
-    // for (int z = 26; z < 38; ++z)
-    // {
-    //     grid->set(x, y, z, Material::GOL);
-    // }
-
-    // // Permanent GOL cube
-    // int cx = 32, cy = 40, cz = 32;
-
-    // for (int dx = 0; dx < 2; ++dx)
-    // for (int dy = 0; dy < 2; ++dy)
-    // for (int dz = 0; dz < 2; ++dz)
-    // {
-    //     grid->set(cx + dx, cy + dy, cz + dz, Material::GOL);
-    // }
+    if (!exporter.finish()) {
+        std::cerr << "Failed to write some frames to " << settings.output << std::endl;
+        return false;
+    }
+    std::cout << "Exported " << settings.frames << " frames over " << tick << " ticks" << std::endl;
+    if (stats && !stats->finish()) {
+        std::cerr << "Failed to write some statistics to " << statsPath << std::endl;
+        return false;
+    }
+    return true;
+}
 
+// Record statistics from now on
+bool App::recordStats(const std::string& path)
+{
+    statsPath = path;
+    return startStats();
+}
 
-    running = true;
-    paused = false;
+// Start the statistics file over for the current grid, from tick 0
+bool App::startStats()
+{
+    if (stats) stats->finish();
+    stats = std::make_unique<StatsRecorder>();
+    statsTick = 0;
+    if (!stats->open(statsPath, *grid)) {
+        stats.reset();
+        return false;
+    }
+    stats->record(*grid, statsTick);
+    return true;
+}
+
+// Load the scene file, replacing the grid and rules
+bool App::loadScene()
+{
+    Scene scene;
+    if (!scene.load(scenePath)) {
+        std::cerr << "Failed to load scene: " << scenePath << std::endl;
+        return false;
+    }
+
+    grid = scene.createGrid();
+    rules = scene.createRules();
+    renderer->reset();
+    camera->setTarget(glm::vec3(grid->getSize() * 0.5f));
+    if (!statsPath.empty()) startStats();
     return true;
 }
 
@@ -190,6 +258,17 @@ void App::handleInput()
     if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) {
         grid->clear();
     }
+
+    // Scene reload, from the binary cache unless the file changed
+    static bool reloadPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS) {
+        if (!reloadPressed) {
+            loadScene();
+            reloadPressed = true;
+        }
+    } else {
+        reloadPressed = false;
+    }
     
     // Pause toggle
     static bool spacePressed = false;
@@ -202,6 +281,51 @@ void App::handleInput()
         spacePressed = false;
     }
 
+    // Tick rate: double or halve the target, F toggles fast-forward within the frame budget
+    static bool fasterPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_EQUAL) == GLFW_PRESS) {
+        if (!fasterPressed) {
+            normalTps = std::min(normalTps * 2.0f, 5120.0f);
+            scheduler.setTargetTps(normalTps);
+            fasterPressed = true;
+        }
+    } else {
+        fasterPressed = false;
+    }
+
+    static bool slowerPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_MINUS) == GLFW_PRESS) {
+        if (!slowerPressed) {
+            normalTps = std::max(normalTps * 0.5f, 1.25f);
+            scheduler.setTargetTps(normalTps);
+            slowerPressed = true;
+        }
+    } else {
+        slowerPressed = false;
+    }
+
+    static bool fastForwardPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) {
+        if (!fastForwardPressed) {
+            scheduler.setTargetTps(scheduler.getTargetTps() == 0.0f ? normalTps : 0.0f);
+            fastForwardPressed = true;
+        }
+    } else {
+        fastForwardPressed = false;
+    }
+
+    // Render mode toggle
+    static bool modePressed = false;
+    if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) {
+        if (!modePressed) {
+            renderer->setMode(renderer->getMode() == RenderMode::INSTANCED
+                              ? RenderMode::RAYMARCH : RenderMode::INSTANCED);
+            modePressed = true;
+        }
+    } else {
+        modePressed = false;
+    }
+
     // Camera flying controls
     float panSpeed = 0.5f;
     glm::vec3 panDelta(0.0f);
@@ -231,13 +355,37 @@ void App::handleInput()
         currentBrush = Material::WALL;
     if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS)
         currentBrush = Material::GOL;
+
+    // Brush size
+    if (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS)
+        brushRadius = std::min(brushRadius + 0.25f, 16.0f);
+    if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS)
+        brushRadius = std::max(brushRadius - 0.25f, 0.0f);
 }
 
 // Update material rules
-void App::update(float deltaTime)
+void App::update()
+{
+    rules->update(*grid);
+    if (stats) stats->record(*grid, ++statsTick);
+}
+
+void App::updateTitle()
 {
-    if (!paused) {
-        Rules::update(*grid);
+    // Tick rate achieved, and whether the grid has settled into a cycle
+    std::string text = "Automata - " + std::to_string((int)(scheduler.getAchievedTps() + 0.5f)) + " TPS";
+    if (scheduler.getTargetTps() == 0.0f) text += " (fast-forward)";
+
+    int period = rules->getPeriod();
+    if (period == 1) {
+        text += " - still life";
+    } else if (period > 1) {
+        text += " - period " + std::to_string(period);
+    }
+
+    if (text != title) {
+        glfwSetWindowTitle(window, text.c_str());
+        title = text;
     }
 }
 
@@ -251,26 +399,38 @@ void App::render()
 void App::run()
 {
     double lastTime = glfwGetTime();
-    const float fixedDeltaTime = 1.0f / 20.0f;  // Simulation timestep
-    float accumulator = 0.0f;
+    const float inputStep = 1.0f / 20.0f;   // Held keys act at this rate, whatever the tick rate
+    float inputAccumulator = 0.0f;
 
     while (running && !glfwWindowShouldClose(window)) {
         double currentTime = glfwGetTime();
         float deltaTime = (float)(currentTime - lastTime);
         lastTime = currentTime;
 
-        if (deltaTime > 0.1f) deltaTime = 0.1f;
-        accumulator += deltaTime;
-
-        while (accumulator >= fixedDeltaTime) {
+        inputAccumulator = std::min(inputAccumulator + deltaTime, 0.1f);
+        while (inputAccumulator >= inputStep) {
             handleInput();
-            update(fixedDeltaTime);
-            accumulator -= fixedDeltaTime;
+            inputAccumulator -= inputStep;
+        }
+
+        if (!paused) {
+            scheduler.runFrame(deltaTime, [this] { update(); });
+        }
+
+        // Programs are rebuilt here since only this thread owns the GL context
+        if (shaderWatcher) {
+            std::vector<std::string> changed = shaderWatcher->takeChanged();
+            if (!changed.empty()) renderer->reloadShaders(changed);
         }
 
+        updateTitle();
         render();
         glfwPollEvents();
     }
+
+    if (stats && !stats->finish()) {
+        std::cerr << "Failed to write some statistics to " << statsPath << std::endl;
+    }
 }
 
 glm::vec3 App::screenToWorldRay(double mouseX, double mouseY)
@@ -294,45 +454,43 @@ glm::vec3 App::screenToWorldRay(double mouseX, double mouseY)
 bool App::raycastGrid(
     const glm::vec3& rayOrigin,
     const glm::vec3& rayDir,
-    glm::ivec3& hitCell
+    RayHit& hit
 ) {
-    const float maxDist = 100.0f;
-    const float step = 0.1f;
-
-    glm::vec3 pos = rayOrigin;
-
-    for (float t = 0; t < maxDist; t += step) {
-        pos += rayDir * step;
+    // Reach anything inside the far clip plane, picking what is drawn rather than the wall shell around it
+    const float maxDist = 1000.0f;
+    return grid->raycast(rayOrigin, rayDir, maxDist, hit, true);
+}
 
-        int x = (int)std::floor(pos.x);
-        int y = (int)std::floor(pos.y);
-        int z = (int)std::floor(pos.z);
+void App::placeMaterial(double mouseX, double mouseY)
+{
+    glm::vec3 rayDir = screenToWorldRay(mouseX, mouseY);
+    glm::vec3 rayOrigin = camera->getPosition();
 
-        if (!grid->inBounds(x, y, z))
-            continue;
+    RayHit hit;
+    if (!raycastGrid(rayOrigin, rayDir, hit) || hit.normal == glm::ivec3(0)) return;
 
-        if (grid->get(x, y, z) != Material::EMPTY) {
-            hitCell = {x, y, z};
-            return true;
-        }
-    }
-    return false;
+    // Place material against the face the ray hit, if that cell is still inside the grid
+    glm::ivec3 cell = hit.cell + hit.normal;
+    if (!grid->inBounds(cell.x, cell.y, cell.z)) return;
+    grid->fillSphere(glm::vec3(cell), brushRadius, currentBrush);
 }
 
-void App::placeMaterial(double mouseX, double mouseY)
+void App::paintStroke(double mouseX, double mouseY)
 {
     glm::vec3 rayDir = screenToWorldRay(mouseX, mouseY);
     glm::vec3 rayOrigin = camera->getPosition();
 
-    glm::ivec3 hit;
-    if (raycastGrid(rayOrigin, rayDir, hit)) {
-        // Place material ABOVE the hit surface
-        int px = hit.x;
-        int py = hit.y + 1;
-        int pz = hit.z;
-
-        if (grid->inBounds(px, py, pz)) {
-            grid->set(px, py, pz, currentBrush);
-        }
+    RayHit hit{};
+    bool placed = raycastGrid(rayOrigin, rayDir, hit) && hit.normal != glm::ivec3(0);
+    glm::ivec3 cell = hit.cell + hit.normal;
+    if (!placed || !grid->inBounds(cell.x, cell.y, cell.z)) {
+        hasLastPaint = false;
+        return;
     }
-}
\ No newline at end of file
+
+    // Join this sample to the previous one so fast drags leave no gaps
+    glm::vec3 p(cell);
+    grid->fillLine(hasLastPaint ? lastPaint : p, p, brushRadius, currentBrush);
+    lastPaint = p;
+    hasLastPaint = true;
+}
@@ -4,9 +4,26 @@
 #include <GLFW/glfw3.h>
 
 #include "../sim/Grid.hpp"
+#include "../sim/Rules.hpp"
+#include "../sim/StatsRecorder.hpp"
 #include "../render/Renderer.hpp"
 #include "../render/Camera.hpp"
+#include "TickScheduler.hpp"
+#include "../utils/FileWatcher.hpp"
 #include <memory>
+#include <string>
+
+/// \brief Offscreen capture of a scripted run
+struct ExportSettings
+{
+    std::string output;                     // Frame file pattern or |encoder command, see FrameExporter
+    int width = 1280;
+    int height = 720;
+    int frames = 300;                       // Frames to write
+    int ticksPerFrame = 1;                  // Simulation ticks between frames
+    std::string cameraPath;                 // Keyframe file, the default view if empty
+    RenderMode mode = RenderMode::INSTANCED;
+};
 
 class App
 {
@@ -16,27 +33,53 @@ public:
     ~App();
 
     /// \brief Initialize simulation and rendering
-    bool initialize();
+    /// \param scenePath Scene description to build the grid from
+    /// \param headless Keep the window hidden, falling back to GLFW's null platform and OSMesa without a display
+    bool initialize(const std::string& scenePath, bool headless = false);
 
     /// \brief Run the main simulation loop
     void run();
 
+    /// \brief Simulate and render frames offscreen, writing them in the background
+    /// \param settings What to capture and where to write it
+    bool exportFrames(const ExportSettings& settings);
+
+    /// \brief Write statistics of every tick to a CSV file, starting over whenever the scene reloads
+    /// \param path File to write
+    bool recordStats(const std::string& path);
+
 private:       
     GLFWwindow* window;                     // GLFW interactable window
     std::unique_ptr<Grid> grid;             // Voxel grid
+    std::unique_ptr<Rules> rules;           // Rule set and random state for the grid
     std::unique_ptr<Renderer> renderer;
     std::unique_ptr<Camera> camera;
+    TickScheduler scheduler;                // Ticks per rendered frame
+    std::unique_ptr<FileWatcher> shaderWatcher;     // Edited shaders to rebuild, interactive runs only
+    std::unique_ptr<StatsRecorder> stats;   // Per-tick statistics, measured in the background
+    std::string statsPath;
+    uint64_t statsTick;
 
     int windowWidth;                        // Window params
     int windowHeight;
     bool running;
     bool paused;
+    std::string scenePath;
+    float normalTps;                        // Target tick rate outside fast-forward
+    std::string title;                      // Window title last set
 
     double lastMouseX, lastMouseY;          // Mouse control
     bool mousePressed;
 
+    bool painting;                          // Right-drag brush strokes
+    bool hasLastPaint;
+    glm::vec3 lastPaint;
+
+    bool loadScene();
+    bool startStats();
     void handleInput();
-    void update(float deltaTime);
+    void update();
+    void updateTitle();
     void render();
 
     // GLFW callbacks
@@ -46,7 +89,9 @@ private:
     static void framebufferSizeCallback(GLFWwindow* w, int width, int height);
 
     Material currentBrush = Material::SAND;
+    float brushRadius = 0.0f;               // Zero places a single voxel
     glm::vec3 screenToWorldRay(double mouseX, double mouseY);
-    bool raycastGrid(const glm::vec3& rayOrigin, const glm::vec3& rayDir, glm::ivec3& hitCell);
+    bool raycastGrid(const glm::vec3& rayOrigin, const glm::vec3& rayDir, RayHit& hit);
     void placeMaterial(double mouseX, double mouseY);
+    void paintStroke(double mouseX, double mouseY);
 };
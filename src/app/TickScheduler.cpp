@@ -0,0 +1,54 @@
+#include "TickScheduler.hpp"
+#include <algorithm>
+
+namespace {
+    constexpr float COST_SMOOTHING = 0.1f;  // Weight of each new tick time in the moving average
+    constexpr float RATE_WINDOW = 0.5f;     // Seconds over which the achieved rate is measured
+}
+
+TickScheduler::TickScheduler(float targetTps, float frameBudget)
+    : targetTps(std::max(targetTps, 0.0f)), frameBudget(frameBudget), owed(0.0f), tickCost(0.0f),
+      windowTime(0.0f), windowTicks(0), achievedTps(0.0f) {}
+
+int TickScheduler::runFrame(float deltaTime, const std::function<void()>& tick)
+{
+    // A target rate owes ticks as time passes; fast-forward just fills the budget
+    int allowed = MAX_TICKS_PER_FRAME;
+    if (targetTps > 0.0f) {
+        owed = std::min(owed + deltaTime * targetTps, targetTps * MAX_BACKLOG);
+        allowed = std::min(allowed, (int)owed);
+    }
+
+    // Stop before the tick that would overrun the budget, judged by the measured cost
+    Clock::time_point start = Clock::now();
+    Clock::time_point last = start;
+    int ticks = 0;
+    while (ticks < allowed) {
+        float spent = std::chrono::duration<float>(last - start).count();
+        if (ticks > 0 && spent + tickCost > frameBudget) break;
+
+        tick();
+        ++ticks;
+
+        Clock::time_point now = Clock::now();
+        float cost = std::chrono::duration<float>(now - last).count();
+        tickCost = tickCost > 0.0f ? tickCost + COST_SMOOTHING * (cost - tickCost) : cost;
+        last = now;
+    }
+    if (targetTps > 0.0f) owed -= ticks;
+
+    windowTime += deltaTime;
+    windowTicks += ticks;
+    if (windowTime >= RATE_WINDOW) {
+        achievedTps = windowTicks / windowTime;
+        windowTime = 0.0f;
+        windowTicks = 0;
+    }
+    return ticks;
+}
+
+void TickScheduler::setTargetTps(float tps)
+{
+    targetTps = std::max(tps, 0.0f);
+    owed = 0.0f;
+}
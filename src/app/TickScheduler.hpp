@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+
+class TickScheduler
+{
+public:
+    static constexpr int MAX_TICKS_PER_FRAME = 4096;   // Bound on one frame, however cheap ticks get
+    static constexpr float MAX_BACKLOG = 1.0f;         // Seconds of owed ticks kept while falling behind
+
+    /// \brief Decides how many simulation ticks each rendered frame runs
+    /// \param targetTps Ticks per second to aim for, zero to run as many as fit in the frame budget
+    /// \param frameBudget Seconds per frame that ticks may use
+    explicit TickScheduler(float targetTps = 20.0f, float frameBudget = 0.012f);
+
+    /// \brief Run this frame's ticks
+    /// \param deltaTime Seconds since the previous frame
+    /// \param tick Advances the simulation by one tick
+    /// \return Number of ticks run
+    int runFrame(float deltaTime, const std::function<void()>& tick);
+
+    /// \brief Set the tick rate to aim for, zero to fast-forward within the frame budget
+    void setTargetTps(float tps);
+
+    /// \brief Get the tick rate aimed for, zero when fast-forwarding
+    float getTargetTps() const { return targetTps; }
+
+    /// \brief Set the seconds per frame that ticks may use
+    void setFrameBudget(float seconds) { frameBudget = seconds; }
+
+    /// \brief Get the seconds per frame that ticks may use
+    float getFrameBudget() const { return frameBudget; }
+
+    /// \brief Get the ticks actually run per second, averaged over the last half second
+    float getAchievedTps() const { return achievedTps; }
+
+    /// \brief Get the smoothed cost of one tick in seconds
+    float getTickCost() const { return tickCost; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    float targetTps;
+    float frameBudget;
+    float owed;             // Ticks due under the target rate but not yet run
+    float tickCost;         // Exponential moving average of measured tick time
+
+    float windowTime;       // Achieved rate measurement window
+    int windowTicks;
+    float achievedTps;
+};
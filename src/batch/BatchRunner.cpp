@@ -0,0 +1,212 @@
+#include "BatchRunner.hpp"
+#include "../utils/ThreadPool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#ifdef __unix__
+#include <unistd.h>
+#endif
+
+namespace {
+    // Live Game of Life cells
+    int countPopulation(const Grid& grid)
+    {
+        return (int)grid.getCurrentBuffer().count(Material::GOL);
+    }
+
+    size_t availableMemory()
+    {
+#if defined(__unix__) && defined(_SC_AVPHYS_PAGES)
+        long pages = sysconf(_SC_AVPHYS_PAGES);
+        long pageSize = sysconf(_SC_PAGESIZE);
+        if (pages > 0 && pageSize > 0) return (size_t)pages * (size_t)pageSize;
+#endif
+        return 0;
+    }
+
+    bool endsWith(const std::string& text, const std::string& suffix)
+    {
+        return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    // Quote text as a JSON string, escaping quotes, backslashes and control characters
+    std::string jsonString(const std::string& text)
+    {
+        static const char hex[] = "0123456789abcdef";
+        std::string out = "\"";
+        for (unsigned char c : text) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (c < 0x20) {
+                        out += "\\u00";
+                        out += hex[c >> 4];
+                        out += hex[c & 15];
+                    } else {
+                        out += (char)c;
+                    }
+            }
+        }
+        return out + '"';
+    }
+}
+
+BatchRunner::BatchRunner(const SweepConfig& config) : config(config) {}
+
+bool BatchRunner::run()
+{
+    if (!scene.load(config.scenePath)) return false;
+    if (!config.densities.empty() && !scene.hasNoise()) {
+        std::cerr << "Warning: " << config.scenePath << " has no noise fill, densities have no effect" << std::endl;
+    }
+
+    std::vector<uint32_t> seeds = config.seeds;
+    std::vector<RuleSet> ruleSets = config.ruleSets;
+    std::vector<float> densities = config.densities;
+    if (seeds.empty()) seeds.push_back(scene.getSeed());
+    if (ruleSets.empty()) ruleSets.push_back(scene.getRuleSet());
+    if (densities.empty()) densities.push_back(-1.0f);
+
+    size_t runs = seeds.size() * ruleSets.size() * densities.size();
+    results.assign(runs, RunResult());
+
+    // Runs fill their own slot, so results come out in sweep order whatever finishes first
+    ThreadPool pool(chooseThreadCount(runs));
+    auto start = std::chrono::steady_clock::now();
+    size_t slot = 0;
+    for (uint32_t seed : seeds) {
+        for (const RuleSet& ruleSet : ruleSets) {
+            for (float density : densities) {
+                RunResult* result = &results[slot++];
+                pool.submit([this, result, seed, ruleSet, density] {
+                    *result = runOne(seed, ruleSet, density);
+                });
+            }
+        }
+    }
+    pool.wait();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << runs << " runs on " << pool.getThreadCount() << " threads in " << seconds << " s ("
+              << (seconds > 0.0 ? runs * 3600.0 / seconds : 0.0) << " simulations/hour)" << std::endl;
+
+    return endsWith(config.outputPath, ".json") ? writeJson(config.outputPath) : writeCsv(config.outputPath);
+}
+
+RunResult BatchRunner::runOne(uint32_t seed, const RuleSet& ruleSet, float density) const
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // Each run gets its own copy of the scene, grid and rules, so runs share nothing
+    Scene variant = scene;
+    variant.setSeed(seed);
+    variant.setRuleSet(ruleSet);
+    if (density >= 0.0f) variant.setDensity(density);
+
+    Grid grid(variant.getSize(), variant.getBoundaries(), config.storage);
+    variant.fill(grid);
+    auto rules = variant.createRules();
+
+    RunResult result{seed, ruleSet, density, 0, -1, -1, 0, 0, 0, 0, {}, 0.0};
+    int population = countPopulation(grid);
+    result.initialPopulation = population;
+    result.peakPopulation = population;
+    result.population.push_back(population);
+
+    for (int tick = 1; tick <= config.ticks; ++tick) {
+        rules->update(grid);
+        population = countPopulation(grid);
+        result.ticksRun = tick;
+        result.peakPopulation = std::max(result.peakPopulation, population);
+        if (tick % config.sampleInterval == 0) result.population.push_back(population);
+
+        // Nothing more to measure once the population is gone or the grid only repeats itself
+        if (population == 0 && result.initialPopulation > 0) result.extinctionTick = tick;
+        if (rules->getPeriod() > 0) {
+            result.cycleTick = (int)rules->getCycleStart();
+            result.period = rules->getPeriod();
+        }
+        if (result.period > 0 || result.extinctionTick >= 0) break;
+    }
+
+    result.finalPopulation = population;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+int BatchRunner::chooseThreadCount(size_t runs) const
+{
+    int threads = config.threads > 0 ? config.threads : (int)std::max(std::thread::hardware_concurrency(), 1u);
+
+    // Each run holds two material buffers, a mass buffer and per-brick bookkeeping
+    size_t cells = (size_t)scene.getSize() * scene.getSize() * scene.getSize();
+    size_t bricks = cells / (Grid::BRICK * Grid::BRICK * Grid::BRICK);
+    size_t cellBytes = (config.storage == CellStorage::PACKED) ? cells / 2 : cells;
+    size_t perRun = 2 * cellBytes + cells + bricks * (sizeof(uint8_t) + sizeof(uint64_t));
+    size_t budget = config.memoryBudget ? config.memoryBudget : availableMemory();
+    if (budget) threads = (int)std::min<size_t>(threads, std::max<size_t>(budget / perRun, 1));
+
+    return (int)std::min<size_t>(threads, std::max<size_t>(runs, 1));
+}
+
+bool BatchRunner::writeCsv(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write results: " << path << std::endl;
+        return false;
+    }
+
+    file << "seed,rules,density,ticks,extinction_tick,cycle_tick,period,initial_population,peak_population,"
+            "final_population,seconds,population\n";
+    for (const RunResult& r : results) {
+        // Rule strings may list counts with commas, so they're quoted
+        file << r.seed << ",\"" << r.ruleSet.toString() << "\",";
+        if (r.density >= 0.0f) file << r.density;
+        file << ',' << r.ticksRun << ',' << r.extinctionTick << ',' << r.cycleTick << ',' << r.period << ','
+             << r.initialPopulation << ',' << r.peakPopulation << ',' << r.finalPopulation << ','
+             << r.seconds << ',';
+
+        // Samples space-separated in one column, so each run stays one row
+        for (size_t i = 0; i < r.population.size(); ++i) {
+            file << (i ? " " : "") << r.population[i];
+        }
+        file << '\n';
+    }
+    return true;
+}
+
+bool BatchRunner::writeJson(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write results: " << path << std::endl;
+        return false;
+    }
+
+    file << "{\n  \"scene\": " << jsonString(config.scenePath) << ",\n  \"sample_interval\": " << config.sampleInterval
+         << ",\n  \"runs\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const RunResult& r = results[i];
+        file << "    {\"seed\": " << r.seed << ", \"rules\": " << jsonString(r.ruleSet.toString()) << ", \"density\": ";
+        if (r.density >= 0.0f) file << r.density; else file << "null";
+        file << ", \"ticks\": " << r.ticksRun << ", \"extinction_tick\": " << r.extinctionTick
+             << ", \"cycle_tick\": " << r.cycleTick << ", \"period\": " << r.period
+             << ", \"initial_population\": " << r.initialPopulation
+             << ", \"peak_population\": " << r.peakPopulation << ", \"final_population\": " << r.finalPopulation
+             << ", \"seconds\": " << r.seconds << ", \"population\": [";
+        for (size_t j = 0; j < r.population.size(); ++j) {
+            file << (j ? ", " : "") << r.population[j];
+        }
+        file << "]}" << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+    file << "  ]\n}\n";
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "../sim/Rules.hpp"
+#include "../sim/Scene.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// \brief Parameter grid for a sweep, every combination of seed, rule set and density is one run
+struct SweepConfig
+{
+    std::string scenePath;
+    std::vector<uint32_t> seeds;
+    std::vector<RuleSet> ruleSets;          // Empty runs the scene's own rules
+    std::vector<float> densities;           // Empty keeps the scene's noise probabilities
+    int ticks = 1000;                       // Tick limit per run
+    int sampleInterval = 10;                // Ticks between population samples
+    int threads = 0;                        // Worker limit, zero for one per core
+    size_t memoryBudget = 0;                // Bytes all concurrent runs may use, zero for available memory
+    CellStorage storage = CellStorage::BYTE;    // Packed halves the memory each run's cells take
+    std::string outputPath = "sweep.csv";   // .json for JSON, CSV otherwise
+};
+
+/// \brief Statistics of one run
+struct RunResult
+{
+    uint32_t seed;
+    RuleSet ruleSet;
+    float density;                  // Negative when the scene's own probabilities were used
+    int ticksRun;                   // Fewer than the limit when the run went extinct or settled
+    int extinctionTick;             // First tick with no live cells, -1 if never
+    int cycleTick;                  // Tick the grid entered a still life or cycle, -1 if never
+    int period;                     // Length of that cycle, 1 for a still life, 0 if none
+    int initialPopulation;
+    int peakPopulation;
+    int finalPopulation;
+    std::vector<int> population;    // Live cells every sampleInterval ticks, from tick 0
+    double seconds;
+};
+
+class BatchRunner
+{
+public:
+    /// \brief Runs independent simulations of one scene across a parameter sweep
+    /// \param config Sweep to run
+    explicit BatchRunner(const SweepConfig& config);
+
+    /// \brief Run every combination on a thread pool and write the results
+    bool run();
+
+    /// \brief Get the results, in seed-major then rule set then density order
+    const std::vector<RunResult>& getResults() const { return results; }
+
+private:
+    SweepConfig config;
+    Scene scene;
+    std::vector<RunResult> results;
+
+    // Build, simulate and measure one combination
+    RunResult runOne(uint32_t seed, const RuleSet& ruleSet, float density) const;
+
+    // Workers that fit both the core count and the memory budget
+    int chooseThreadCount(size_t runs) const;
+
+    // Write results as one row or object per run
+    bool writeCsv(const std::string& path) const;
+    bool writeJson(const std::string& path) const;
+};
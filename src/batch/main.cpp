@@ -0,0 +1,126 @@
+#include "BatchRunner.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+    // Most seeds one --seeds value may expand to, each is a whole run
+    constexpr unsigned long MAX_SEEDS = 1000000;
+
+    void printUsage()
+    {
+        std::cerr << "Usage: automata_batch <scene> [options]\n"
+                     "  --seeds A-B|A,B,...    Seeds to run, default the scene's seed\n"
+                     "  --rules S../B..        Rule set to run, repeat for more, default the scene's rules\n"
+                     "  --densities P,Q,...    Noise fill probabilities, default the scene's own\n"
+                     "  --ticks N              Tick limit per run (1000)\n"
+                     "  --sample N             Ticks between population samples (10)\n"
+                     "  --threads N            Worker limit, default one per core\n"
+                     "  --memory MB            Memory budget for concurrent runs, default available memory\n"
+                     "  --packed               Store cells two to a byte, to fit more or larger runs\n"
+                     "  -o, --output FILE      Results file, .json for JSON, CSV otherwise (sweep.csv)\n";
+    }
+
+    // Comma-separated seeds, each either a single value or an inclusive range
+    bool parseSeeds(const std::string& text, std::vector<uint32_t>& seeds)
+    {
+        std::istringstream in(text);
+        std::string item;
+        while (std::getline(in, item, ',')) {
+            char* end;
+            unsigned long lo = std::strtoul(item.c_str(), &end, 10);
+            unsigned long hi = lo;
+            if (end == item.c_str()) return false;
+            if (*end == '-') {
+                const char* start = end + 1;
+                hi = std::strtoul(start, &end, 10);
+                if (end == start || hi < lo) return false;
+            }
+            if (*end != '\0' || lo > UINT32_MAX || hi > UINT32_MAX) return false;
+            if (hi - lo >= MAX_SEEDS - std::min<size_t>(seeds.size(), MAX_SEEDS)) {
+                std::cerr << "Seed range " << item << " is too large, at most " << MAX_SEEDS << " seeds per sweep"
+                          << std::endl;
+                return false;
+            }
+            for (unsigned long s = lo; s <= hi; ++s) seeds.push_back((uint32_t)s);
+        }
+        return !seeds.empty();
+    }
+
+    bool parseDensities(const std::string& text, std::vector<float>& densities)
+    {
+        std::istringstream in(text);
+        std::string item;
+        while (std::getline(in, item, ',')) {
+            char* end;
+            float p = std::strtof(item.c_str(), &end);
+            if (end == item.c_str() || *end != '\0' || p < 0.0f || p > 1.0f) return false;
+            densities.push_back(p);
+        }
+        return !densities.empty();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printUsage();
+        return 1;
+    }
+
+    SweepConfig config;
+    config.scenePath = argv[1];
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--packed") {
+            config.storage = CellStorage::PACKED;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            printUsage();
+            return 1;
+        }
+        std::string value = argv[++i];
+
+        bool ok = true;
+        if (arg == "--seeds") {
+            ok = parseSeeds(value, config.seeds);
+        } else if (arg == "--rules") {
+            RuleSet ruleSet;
+            ok = RuleSet::parse(value, ruleSet);
+            if (ok) config.ruleSets.push_back(ruleSet);
+        } else if (arg == "--densities") {
+            ok = parseDensities(value, config.densities);
+        } else if (arg == "--ticks") {
+            config.ticks = std::atoi(value.c_str());
+            ok = config.ticks > 0;
+        } else if (arg == "--sample") {
+            config.sampleInterval = std::atoi(value.c_str());
+            ok = config.sampleInterval > 0;
+        } else if (arg == "--threads") {
+            config.threads = std::atoi(value.c_str());
+            ok = config.threads > 0;
+        } else if (arg == "--memory") {
+            config.memoryBudget = (size_t)std::atoll(value.c_str()) << 20;
+            ok = config.memoryBudget > 0;
+        } else if (arg == "-o" || arg == "--output") {
+            config.outputPath = value;
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            printUsage();
+            return 1;
+        }
+
+        if (!ok) {
+            std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+            return 1;
+        }
+    }
+
+    BatchRunner runner(config);
+    return runner.run() ? 0 : 1;
+}
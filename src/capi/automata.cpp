@@ -0,0 +1,194 @@
+#include "automata.h"
+#include "../sim/Scene.hpp"
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <new>
+
+static_assert((int)AUTOMATA_WALL == (int)Material::WALL && (int)AUTOMATA_GOL == (int)Material::GOL,
+              "C materials match the stored values");
+static_assert((int)AUTOMATA_BOUNDARY_OPEN == (int)Boundary::OPEN, "C boundaries match the grid's");
+
+struct automata_grid
+{
+    std::unique_ptr<Grid> grid;
+    std::unique_ptr<Rules> rules;
+    uint64_t tick = 0;
+};
+
+namespace {
+    CellStorage toStorage(automata_storage storage)
+    {
+        return storage == AUTOMATA_PACKED ? CellStorage::PACKED : CellStorage::BYTE;
+    }
+
+    bool validMaterial(automata_material material)
+    {
+        return (int)material >= 0 && (int)material < (int)Material::COUNT;
+    }
+
+    // Fill a view of a buffer of cells, each bits wide, laid out like the grid
+    void describe(const Grid& grid, const void* data, int bits, automata_view* view)
+    {
+        const int64_t size = grid.getSize();
+        view->data = data;
+        view->dims[0] = (int32_t)size;
+        view->dims[1] = (int32_t)size;
+        view->dims[2] = grid.getDepth();
+        view->strides[0] = (bits == 8) ? 1 : 0;
+        view->strides[1] = size * bits / 8;
+        view->strides[2] = size * size * bits / 8;
+        view->bits = bits;
+        view->revision = grid.getRevision();
+    }
+}
+
+uint32_t automata_api_version(void)
+{
+    return AUTOMATA_API_VERSION;
+}
+
+size_t automata_memory_size(int size, automata_storage storage)
+{
+    if (size <= 0) return 0;
+    size_t n = (size_t)Grid::roundSize(size);
+    return 2 * CellBuffer::bytesFor(n * n * n, toStorage(storage));
+}
+
+automata_grid* automata_create(int size, const automata_boundary boundaries[3], automata_storage storage,
+                               uint32_t seed, const char* rules, void* memory, size_t memory_size)
+{
+    if (size <= 0) {
+        std::cerr << "Grid size must be positive" << std::endl;
+        return nullptr;
+    }
+    if (memory && memory_size < automata_memory_size(size, storage)) {
+        std::cerr << "Grid memory of " << memory_size << " bytes is smaller than the "
+                  << automata_memory_size(size, storage) << " needed" << std::endl;
+        return nullptr;
+    }
+
+    Boundaries gridBoundaries = {Boundary::WALL, Boundary::WALL, Boundary::WALL};
+    for (int axis = 0; boundaries && axis < 3; ++axis) {
+        if ((int)boundaries[axis] < 0 || (int)boundaries[axis] > (int)AUTOMATA_BOUNDARY_OPEN) {
+            std::cerr << "Invalid boundary for axis " << axis << std::endl;
+            return nullptr;
+        }
+        gridBoundaries[axis] = (Boundary)boundaries[axis];
+    }
+
+    RuleSet ruleSet;
+    if (rules && !RuleSet::parse(rules, ruleSet)) {
+        std::cerr << "Invalid rules: " << rules << std::endl;
+        return nullptr;
+    }
+
+    // Nothing may throw across the C boundary
+    try {
+        auto handle = std::make_unique<automata_grid>();
+        handle->grid = std::make_unique<Grid>(size, gridBoundaries, toStorage(storage), 0, -1,
+                                              static_cast<uint8_t*>(memory));
+        handle->rules = std::make_unique<Rules>(ruleSet, seed);
+        return handle.release();
+    } catch (const std::bad_alloc&) {
+        std::cerr << "Out of memory creating a grid of size " << size << std::endl;
+        return nullptr;
+    }
+}
+
+automata_grid* automata_load_scene(const char* path, automata_storage storage)
+{
+    if (!path) return nullptr;
+    try {
+        Scene scene;
+        if (!scene.load(path)) return nullptr;
+        auto handle = std::make_unique<automata_grid>();
+        handle->grid = scene.createGrid(toStorage(storage));
+        handle->rules = scene.createRules();
+        return handle.release();
+    } catch (const std::bad_alloc&) {
+        std::cerr << "Out of memory loading scene " << path << std::endl;
+        return nullptr;
+    }
+}
+
+void automata_destroy(automata_grid* grid)
+{
+    delete grid;
+}
+
+bool automata_step(automata_grid* grid, int ticks)
+{
+    if (!grid) return false;
+    for (int t = 0; t < ticks; ++t) {
+        try {
+            grid->rules->update(*grid->grid);
+        } catch (const std::exception& e) {
+            std::cerr << "Step failed at tick " << grid->tick << ": " << e.what() << std::endl;
+            return false;
+        } catch (...) {
+            std::cerr << "Step failed at tick " << grid->tick << std::endl;
+            return false;
+        }
+        ++grid->tick;
+    }
+    return true;
+}
+
+int automata_get_size(const automata_grid* grid)
+{
+    return grid->grid->getSize();
+}
+
+uint64_t automata_get_tick(const automata_grid* grid)
+{
+    return grid->tick;
+}
+
+int automata_get_period(const automata_grid* grid)
+{
+    return grid->rules->getPeriod();
+}
+
+automata_material automata_get(const automata_grid* grid, int x, int y, int z)
+{
+    return (automata_material)grid->grid->get(x, y, z);
+}
+
+void automata_set(automata_grid* grid, int x, int y, int z, automata_material material)
+{
+    if (!validMaterial(material)) return;
+    grid->grid->set(x, y, z, (Material)material);
+}
+
+void automata_fill_box(automata_grid* grid, const int lo[3], const int hi[3], automata_material material)
+{
+    if (!validMaterial(material)) return;
+    grid->grid->fillBox(glm::ivec3(lo[0], lo[1], lo[2]), glm::ivec3(hi[0], hi[1], hi[2]), (Material)material);
+}
+
+void automata_fill_sphere(automata_grid* grid, const float center[3], float radius, automata_material material)
+{
+    if (!validMaterial(material)) return;
+    grid->grid->fillSphere(glm::vec3(center[0], center[1], center[2]), radius, (Material)material);
+}
+
+void automata_clear(automata_grid* grid)
+{
+    grid->grid->clear();
+}
+
+bool automata_view_cells(const automata_grid* grid, automata_view* view)
+{
+    if (!grid || !view) return false;
+    const CellBuffer& cells = grid->grid->getCurrentBuffer();
+    describe(*grid->grid, cells.data(), cells.isPacked() ? 4 : 8, view);
+    return true;
+}
+
+bool automata_view_mass(const automata_grid* grid, automata_view* view)
+{
+    if (!grid || !view) return false;
+    describe(*grid->grid, grid->grid->getMassBuffer().data(), 8, view);
+    return true;
+}
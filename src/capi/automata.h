@@ -0,0 +1,137 @@
+#pragma once
+
+/*
+ * C interface to the simulation, for embedding it in other programs and languages.
+ * Grids are opaque handles; cell state is read in place through views, without copying.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+    #if defined(AUTOMATA_BUILD)
+        #define AUTOMATA_API __declspec(dllexport)
+    #else
+        #define AUTOMATA_API __declspec(dllimport)
+    #endif
+#else
+    #define AUTOMATA_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped whenever a declaration below changes incompatibly */
+#define AUTOMATA_API_VERSION 2
+
+typedef struct automata_grid automata_grid;
+
+/* Cell materials, matching the values stored in byte cells */
+typedef enum automata_material
+{
+    AUTOMATA_EMPTY = 0,
+    AUTOMATA_SAND = 1,
+    AUTOMATA_WATER = 2,
+    AUTOMATA_GOL = 3,
+    AUTOMATA_WALL = 4
+} automata_material;
+
+/* How cells are stored: a byte each, or two to a byte with the even cell in the low nibble */
+typedef enum automata_storage
+{
+    AUTOMATA_BYTE = 0,
+    AUTOMATA_PACKED = 1
+} automata_storage;
+
+/* What lies beyond a pair of opposite grid faces */
+typedef enum automata_boundary
+{
+    AUTOMATA_BOUNDARY_WALL = 0,
+    AUTOMATA_BOUNDARY_PERIODIC = 1,
+    AUTOMATA_BOUNDARY_OPEN = 2
+} automata_boundary;
+
+/*
+ * Read-only view of a grid buffer, valid until the grid is next stepped, edited or destroyed.
+ * Element (x, y, z) starts at data + x * strides[0] + y * strides[1] + z * strides[2].
+ * Packed cells have a bits value of 4 and an x stride of 0: cell x sits in byte x / 2 of its row,
+ * in the low nibble when x is even.
+ */
+typedef struct automata_view
+{
+    const void* data;
+    int32_t dims[3];        /* Cells along x, y and z */
+    int64_t strides[3];     /* Bytes between neighbouring cells along x, y and z */
+    int32_t bits;           /* Bits per cell, 8 or 4 */
+    uint64_t revision;      /* Grid revision the view was taken at */
+} automata_view;
+
+/* Get AUTOMATA_API_VERSION as the library was built */
+AUTOMATA_API uint32_t automata_api_version(void);
+
+/* Get the bytes of caller memory a grid of a size and storage needs for its cells */
+AUTOMATA_API size_t automata_memory_size(int size, automata_storage storage);
+
+/*
+ * Create an empty grid, walls included on wall faces.
+ * size: Edge length in cells, rounded up to a multiple of 8
+ * boundaries: Boundary of x, y and z, null for walls on every face
+ * rules: Game of Life rules such as "S5-7/B6", null for the default
+ * memory: Caller memory of automata_memory_size bytes for the cells, null to allocate; it is cleared,
+ *         must outlive the grid, and holds the current cells in either half from one step to the next
+ * Returns null on failure, with the reason written to stderr.
+ */
+AUTOMATA_API automata_grid* automata_create(int size, const automata_boundary boundaries[3],
+                                            automata_storage storage, uint32_t seed, const char* rules,
+                                            void* memory, size_t memory_size);
+
+/* Create a grid from a scene file, null on failure */
+AUTOMATA_API automata_grid* automata_load_scene(const char* path, automata_storage storage);
+
+/* Destroy a grid, null is ignored */
+AUTOMATA_API void automata_destroy(automata_grid* grid);
+
+/*
+ * Advance a grid by a number of ticks.
+ * Returns false if a tick failed, with the reason written to stderr; the ticks before it stand,
+ * and the grid should be cleared or destroyed before it is stepped again.
+ */
+AUTOMATA_API bool automata_step(automata_grid* grid, int ticks);
+
+/* Get the edge length in cells */
+AUTOMATA_API int automata_get_size(const automata_grid* grid);
+
+/* Get the number of ticks stepped */
+AUTOMATA_API uint64_t automata_get_tick(const automata_grid* grid);
+
+/* Get the length of the cycle the grid has settled into, 1 for a still life and 0 if none */
+AUTOMATA_API int automata_get_period(const automata_grid* grid);
+
+/* Get the material of a cell, following the boundaries outside the grid */
+AUTOMATA_API automata_material automata_get(const automata_grid* grid, int x, int y, int z);
+
+/* Set the material of a cell, ignored outside the grid */
+AUTOMATA_API void automata_set(automata_grid* grid, int x, int y, int z, automata_material material);
+
+/* Fill the box [lo, hi) with a material, clipped to the grid */
+AUTOMATA_API void automata_fill_box(automata_grid* grid, const int lo[3], const int hi[3],
+                                    automata_material material);
+
+/* Fill every cell whose centre lies within a sphere */
+AUTOMATA_API void automata_fill_sphere(automata_grid* grid, const float center[3], float radius,
+                                       automata_material material);
+
+/* Empty the whole grid, walls included */
+AUTOMATA_API void automata_clear(automata_grid* grid);
+
+/* View the current cells in the grid's storage */
+AUTOMATA_API bool automata_view_cells(const automata_grid* grid, automata_view* view);
+
+/* View the water mass, a byte per cell, 192 for a full uncompressed cell */
+AUTOMATA_API bool automata_view_mass(const automata_grid* grid, automata_view* view);
+
+#ifdef __cplusplus
+}
+#endif
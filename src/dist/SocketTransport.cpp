@@ -0,0 +1,134 @@
+#include "SocketTransport.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+std::unique_ptr<SocketTransport> SocketTransport::spawn(int processes)
+{
+    // One socket pair per pair of ranks, the lower rank keeping the first end
+    std::vector<std::vector<int>> ends(processes, std::vector<int>(processes, -1));
+    for (int a = 0; a < processes; ++a) {
+        for (int b = a + 1; b < processes; ++b) {
+            int sv[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+                std::cerr << "Failed to create socket pair: " << std::strerror(errno) << std::endl;
+                for (auto& row : ends) for (int fd : row) if (fd >= 0) close(fd);
+                return nullptr;
+            }
+            ends[a][b] = sv[0];
+            ends[b][a] = sv[1];
+        }
+    }
+
+    // Buffered output would otherwise be written once by every process
+    std::fflush(nullptr);
+    std::cout.flush();
+
+    int rank = 0;
+    std::vector<pid_t> children;
+    for (int r = 1; r < processes; ++r) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::cerr << "Failed to fork: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        if (pid == 0) {
+            rank = r;
+            children.clear();
+            break;
+        }
+        children.push_back(pid);
+    }
+
+    // Keep only this rank's ends, a peer that never started shows up as a closed socket
+    std::vector<int> peers(processes, -1);
+    for (int a = 0; a < processes; ++a) {
+        for (int b = 0; b < processes; ++b) {
+            if (ends[a][b] < 0) continue;
+            if (a == rank) {
+                peers[b] = ends[a][b];
+                fcntl(peers[b], F_SETFL, fcntl(peers[b], F_GETFL) | O_NONBLOCK);
+            } else {
+                close(ends[a][b]);
+            }
+        }
+    }
+    return std::unique_ptr<SocketTransport>(new SocketTransport(rank, std::move(peers), std::move(children)));
+}
+
+SocketTransport::SocketTransport(int rank, std::vector<int> peers, std::vector<pid_t> children)
+    : rank(rank), peers(std::move(peers)), children(std::move(children)) {}
+
+SocketTransport::~SocketTransport()
+{
+    for (int fd : peers) {
+        if (fd >= 0) close(fd);
+    }
+    for (pid_t pid : children) {
+        int status;
+        waitpid(pid, &status, 0);
+    }
+}
+
+bool SocketTransport::exchange(int to, const void* data, size_t bytes, int from, std::vector<uint8_t>& in)
+{
+    // Each message is its length followed by its bytes
+    uint64_t length = bytes;
+    size_t sent = (to < 0) ? sizeof(length) + bytes : 0;
+    uint64_t expected = 0;
+    size_t received = 0;
+    bool haveLength = from < 0;
+    in.clear();
+
+    // Sending and receiving together keeps two ranks sending large messages to each other from deadlocking
+    while (sent < sizeof(length) + bytes || !haveLength || received < expected) {
+        bool sending = sent < sizeof(length) + bytes;
+        bool receiving = !haveLength || received < expected;
+        pollfd fds[2];
+        int count = 0;
+        if (sending) fds[count++] = {peers[to], POLLOUT, 0};
+        if (receiving) fds[count++] = {peers[from], POLLIN, 0};
+        if (poll(fds, count, -1) < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Failed to poll sockets: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        if (sending && (fds[0].revents & (POLLOUT | POLLERR | POLLHUP))) {
+            const uint8_t* src = (sent < sizeof(length))
+                ? reinterpret_cast<const uint8_t*>(&length) + sent
+                : static_cast<const uint8_t*>(data) + (sent - sizeof(length));
+            size_t chunk = (sent < sizeof(length)) ? sizeof(length) - sent : sizeof(length) + bytes - sent;
+            ssize_t n = send(peers[to], src, chunk, MSG_NOSIGNAL);
+            if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                std::cerr << "Failed to send to rank " << to << ": " << std::strerror(errno) << std::endl;
+                return false;
+            }
+            if (n > 0) sent += (size_t)n;
+        }
+
+        const pollfd& incoming = fds[count - 1];
+        if (receiving && (incoming.revents & (POLLIN | POLLERR | POLLHUP))) {
+            uint8_t* dst = haveLength ? in.data() + received : reinterpret_cast<uint8_t*>(&expected) + received;
+            size_t chunk = haveLength ? expected - received : sizeof(expected) - received;
+            ssize_t n = recv(peers[from], dst, chunk, 0);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+                std::cerr << "Lost connection to rank " << from << std::endl;
+                return false;
+            }
+            if (n > 0) received += (size_t)n;
+            if (!haveLength && received == sizeof(expected)) {
+                haveLength = true;
+                received = 0;
+                in.resize(expected);
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "../sim/Transport.hpp"
+#include <memory>
+#include <vector>
+#include <sys/types.h>
+
+class SocketTransport : public Transport
+{
+public:
+    /// \brief Fork into local processes joined pairwise by Unix sockets
+    /// Each process returns from here with its own transport, rank 0 being the original process
+    /// \param processes Number of processes, including this one
+    /// \return Null if the sockets or processes could not be created
+    static std::unique_ptr<SocketTransport> spawn(int processes);
+
+    /// \brief Close the sockets, rank 0 also waits for the other processes to exit
+    ~SocketTransport() override;
+
+    SocketTransport(const SocketTransport&) = delete;
+    SocketTransport& operator=(const SocketTransport&) = delete;
+
+    int getRank() const override { return rank; }
+    int getSize() const override { return (int)peers.size(); }
+    bool exchange(int to, const void* data, size_t bytes, int from, std::vector<uint8_t>& in) override;
+
+private:
+    int rank;
+    std::vector<int> peers;         // Socket to each rank, -1 for this one
+    std::vector<pid_t> children;    // Processes forked by rank 0
+
+    SocketTransport(int rank, std::vector<int> peers, std::vector<pid_t> children);
+};
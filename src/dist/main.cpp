@@ -0,0 +1,127 @@
+#include "SocketTransport.hpp"
+#include "../sim/Decomposition.hpp"
+#include "../sim/Scene.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+    void printUsage()
+    {
+        std::cerr << "Usage: automata_dist <scene> [options]\n"
+                     "  --processes N          Processes to split the grid's z between (2)\n"
+                     "  --ticks N              Ticks to run (100)\n"
+                     "  --verify               Also run the whole grid in one process, with byte cells, and compare\n"
+                     "  --packed               Store cells two to a byte\n"
+                     "  -o, --output FILE      Write the final cells, one byte each, x fastest then y then z\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printUsage();
+        return 1;
+    }
+
+    std::string scenePath = argv[1];
+    std::string outputPath;
+    int processes = 2;
+    int ticks = 100;
+    bool verify = false;
+    CellStorage storage = CellStorage::BYTE;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        bool ok = true;
+        if (arg == "--processes" && hasValue) {
+            processes = std::atoi(argv[++i]);
+            ok = processes > 0;
+        } else if (arg == "--ticks" && hasValue) {
+            ticks = std::atoi(argv[++i]);
+            ok = ticks >= 0;
+        } else if (arg == "--verify") {
+            verify = true;
+        } else if (arg == "--packed") {
+            storage = CellStorage::PACKED;
+        } else if ((arg == "-o" || arg == "--output") && hasValue) {
+            outputPath = argv[++i];
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            std::cerr << "Invalid argument: " << arg << std::endl;
+            printUsage();
+            return 1;
+        }
+    }
+
+    Scene scene;
+    if (!scene.load(scenePath)) return 1;
+
+    // Every slab needs at least one layer of bricks
+    const int size = Grid::roundSize(scene.getSize());
+    if (processes > size / Grid::BRICK) {
+        std::cerr << "A grid of size " << size << " splits into at most " << size / Grid::BRICK
+                  << " processes" << std::endl;
+        return 1;
+    }
+
+    auto transport = SocketTransport::spawn(processes);
+    if (!transport) return 1;
+
+    Decomposition decomposition(*transport, size, scene.getBoundaries()[2]);
+    Grid slab(size, scene.getBoundaries(), storage, decomposition.getBegin(), decomposition.getEnd());
+    scene.fill(slab);
+    auto rules = scene.createRules();
+    rules->setDecomposition(&decomposition);
+    for (int t = 0; t < ticks && decomposition.ok(); ++t) {
+        rules->update(slab);
+    }
+
+    // Only rank 0 holds the whole grid
+    Grid full(size, scene.getBoundaries(), storage);
+    if (!decomposition.gather(slab, full)) return 1;
+    if (decomposition.getRank() != 0) return 0;
+
+    const CellBuffer& cells = full.getCurrentBuffer();
+    std::printf("%d processes, %d ticks: hash %016llx, sand %zu, water %zu, life %zu\n", processes, ticks,
+                (unsigned long long)full.fingerprint(), cells.count(Material::SAND), cells.count(Material::WATER),
+                cells.count(Material::GOL));
+
+    if (!outputPath.empty()) {
+        std::vector<uint8_t> bytes(cells.size());
+        for (size_t i = 0; i < cells.size(); ++i) bytes[i] = (uint8_t)cells[i];
+        std::ofstream file(outputPath, std::ios::binary | std::ios::trunc);
+        if (!file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size())) {
+            std::cerr << "Failed to write " << outputPath << std::endl;
+            return 1;
+        }
+    }
+
+    if (verify) {
+        Grid whole(size, scene.getBoundaries());
+        scene.fill(whole);
+        auto serial = scene.createRules();
+        for (int t = 0; t < ticks; ++t) {
+            serial->update(whole);
+        }
+
+        size_t differing = 0;
+        for (size_t i = 0; i < cells.size(); ++i) {
+            differing += whole.getCurrentBuffer()[i] != cells[i]
+                      || whole.getMassBuffer()[i] != full.getMassBuffer()[i];
+        }
+        if (differing) {
+            std::printf("Mismatch: %zu cells differ from the single-process run\n", differing);
+            return 1;
+        }
+        std::printf("Matches the single-process run\n");
+    }
+    return 0;
+}
@@ -1,14 +1,77 @@
 #include "app/App.hpp"
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <string>
 
-int main()
+namespace {
+    void printUsage()
+    {
+        std::cerr << "Usage: automata [scene] [options]\n"
+                     "  --export PATTERN       Render offscreen to frame_%05d.png/.ppm, or '|command' for raw RGB24\n"
+                     "  --frames N             Frames to export (300)\n"
+                     "  --every N              Simulation ticks between exported frames (1)\n"
+                     "  --size WxH             Exported frame size (1280x720)\n"
+                     "  --camera FILE          Camera keyframes, one \"tick yaw pitch distance tx ty tz\" per line\n"
+                     "  --raymarch             Export with the raymarched renderer\n"
+                     "  --stats FILE           Write population, cluster and surface statistics of every tick as CSV\n";
+    }
+}
+
+int main(int argc, char** argv)
 {
     App app;
 
-    if (!app.initialize()) {
+    // Optional scene file, the default pool and sand pile otherwise
+    std::string scenePath = "scenes/default.scene";
+    ExportSettings exportSettings;
+    std::string statsPath;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        bool ok = true;
+        if (arg == "--export" && hasValue) {
+            exportSettings.output = argv[++i];
+        } else if (arg == "--frames" && hasValue) {
+            exportSettings.frames = std::atoi(argv[++i]);
+            ok = exportSettings.frames > 0;
+        } else if (arg == "--every" && hasValue) {
+            exportSettings.ticksPerFrame = std::atoi(argv[++i]);
+            ok = exportSettings.ticksPerFrame > 0;
+        } else if (arg == "--size" && hasValue) {
+            ok = std::sscanf(argv[++i], "%dx%d", &exportSettings.width, &exportSettings.height) == 2
+                 && exportSettings.width > 0 && exportSettings.height > 0;
+        } else if (arg == "--camera" && hasValue) {
+            exportSettings.cameraPath = argv[++i];
+        } else if (arg == "--stats" && hasValue) {
+            statsPath = argv[++i];
+        } else if (arg == "--raymarch") {
+            exportSettings.mode = RenderMode::RAYMARCH;
+        } else if (arg[0] != '-') {
+            scenePath = arg;
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            std::cerr << "Invalid argument: " << arg << std::endl;
+            printUsage();
+            return 1;
+        }
+    }
+
+    bool exporting = !exportSettings.output.empty();
+    if (!app.initialize(scenePath, exporting)) {
         std::cerr << "Failed to initialize application" << std::endl;
         return 1;
     }
+    if (!statsPath.empty() && !app.recordStats(statsPath)) {
+        return 1;
+    }
+
+    if (exporting) {
+        return app.exportFrames(exportSettings) ? 0 : 1;
+    }
 
     app.run();
     return 0;
@@ -1,6 +1,7 @@
 #include "Camera.hpp"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/euler_angles.hpp>
+#include <algorithm>
 #include <cmath>
 
 // Consntructor
@@ -64,6 +65,22 @@ void Camera::pan(const glm::vec3& delta)
     target += delta;
 }
 
+// Set camera orbit
+void Camera::setOrbit(float yaw, float pitch, float distance)
+{
+    this->yaw = yaw;
+    this->pitch = std::clamp(pitch, -89.0f, 89.0f);
+    this->distance = distance;
+    updatePosition();
+}
+
+// Retarget camera
+void Camera::setTarget(const glm::vec3& target)
+{
+    this->target = target;
+    updatePosition();
+}
+
 // Manually set camera aspect ratio
 void Camera::setAspectRatio(float aspect)
 {
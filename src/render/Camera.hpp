@@ -17,6 +17,9 @@ public:
     /// \brief Return the camera's position
     glm::vec3 getPosition() const;
 
+    /// \brief Return the camera's vertical field of view in degrees
+    float getFov() const { return fov; }
+
     /// \brief Rotate the camera view
     /// \param deltaX Rotation about the yaw axis
     /// \param deltaY Rotation about the pitch axis
@@ -26,6 +29,16 @@ public:
     /// \param zoom How much to zoom in
     void zoom(float delta);
 
+    /// \brief Place the camera on its orbit directly
+    /// \param yaw Rotation about the target in degrees
+    /// \param pitch Elevation above the target in degrees
+    /// \param distance Distance from the target
+    void setOrbit(float yaw, float pitch, float distance);
+
+    /// \brief Point the camera at a new target, keeping its orbit
+    /// \param target Point to orbit around
+    void setTarget(const glm::vec3& target);
+
     /// \brief Pan the camera
     /// \param delta How much to move the camera in xyz
     void pan(const glm::vec3& delta);
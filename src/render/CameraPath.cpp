@@ -0,0 +1,50 @@
+#include "CameraPath.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+CameraPath::CameraPath() {}
+
+bool CameraPath::load(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open camera path: " << path << std::endl;
+        return false;
+    }
+
+    keys.clear();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        std::istringstream in(line.substr(0, line.find('#')));
+        Key key;
+        if (!(in >> key.tick)) continue;
+        if (!(in >> key.yaw >> key.pitch >> key.distance >> key.target.x >> key.target.y >> key.target.z)) {
+            std::cerr << "Camera path " << path << ":" << lineNumber
+                      << ": expected tick yaw pitch distance tx ty tz" << std::endl;
+            return false;
+        }
+        keys.push_back(key);
+    }
+
+    std::stable_sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) { return a.tick < b.tick; });
+    return true;
+}
+
+void CameraPath::apply(float tick, Camera& camera) const
+{
+    if (keys.empty()) return;
+
+    // Find the keyframes either side of the tick
+    auto next = std::upper_bound(keys.begin(), keys.end(), tick,
+                                 [](float t, const Key& key) { return t < key.tick; });
+    const Key& b = (next == keys.end()) ? keys.back() : *next;
+    const Key& a = (next == keys.begin()) ? keys.front() : *(next - 1);
+    float t = (b.tick > a.tick) ? std::clamp((tick - a.tick) / (b.tick - a.tick), 0.0f, 1.0f) : 0.0f;
+
+    camera.setOrbit(glm::mix(a.yaw, b.yaw, t), glm::mix(a.pitch, b.pitch, t), glm::mix(a.distance, b.distance, t));
+    camera.setTarget(glm::mix(a.target, b.target, t));
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Camera.hpp"
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+class CameraPath
+{
+public:
+    /// \brief Scripted camera keyframes, interpolated linearly by tick
+    CameraPath();
+
+    /// \brief Read keyframes, one "tick yaw pitch distance tx ty tz" per line with # comments
+    /// \param path Path to the camera path file
+    bool load(const std::string& path);
+
+    /// \brief Pose a camera at a tick, holding the first and last keyframes outside the path
+    /// \param tick Simulation tick
+    /// \param camera Camera to pose
+    void apply(float tick, Camera& camera) const;
+
+    /// \brief Check if any keyframes are loaded
+    bool empty() const { return keys.empty(); }
+
+private:
+    struct Key
+    {
+        float tick;
+        float yaw, pitch, distance;
+        glm::vec3 target;
+    };
+
+    std::vector<Key> keys;      // Sorted by tick
+};
@@ -0,0 +1,193 @@
+#include "FrameExporter.hpp"
+#include "../utils/ImageWriter.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    bool endsWith(const std::string& text, const std::string& suffix)
+    {
+        return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    // The pattern goes to snprintf as its format, so it may hold exactly one int conversion such as %05d,
+    // with only flags, a width and a precision, and no other conversion but %%
+    bool isFramePattern(const std::string& pattern)
+    {
+        int conversions = 0;
+        for (size_t i = 0; i < pattern.size(); ++i) {
+            if (pattern[i] != '%') continue;
+            if (++i < pattern.size() && pattern[i] == '%') continue;
+            while (i < pattern.size() && std::strchr("-+ #0", pattern[i])) ++i;
+            while (i < pattern.size() && std::isdigit((unsigned char)pattern[i])) ++i;
+            if (i < pattern.size() && pattern[i] == '.') {
+                ++i;
+                while (i < pattern.size() && std::isdigit((unsigned char)pattern[i])) ++i;
+            }
+            if (i >= pattern.size() || (pattern[i] != 'd' && pattern[i] != 'i')) return false;
+            ++conversions;
+        }
+        return conversions == 1;
+    }
+}
+
+FrameExporter::FrameExporter() : width(0), height(0), pipe(nullptr), fbo(0), colorRBO(0), depthRBO(0),
+                                 pbos{}, issued(0), collected(0), closing(false), failed(false) {}
+
+FrameExporter::~FrameExporter()
+{
+    finish();
+    if (pbos[0]) glDeleteBuffers(PBO_COUNT, pbos);
+    if (colorRBO) glDeleteRenderbuffers(1, &colorRBO);
+    if (depthRBO) glDeleteRenderbuffers(1, &depthRBO);
+    if (fbo) glDeleteFramebuffers(1, &fbo);
+}
+
+bool FrameExporter::initialize(int width, int height, const std::string& output)
+{
+    this->width = width;
+    this->height = height;
+    this->output = output;
+
+    if (!output.empty() && output[0] == '|') {
+        pipe = popen(output.c_str() + 1, "w");
+        if (!pipe) {
+            std::cerr << "Failed to start encoder: " << output.substr(1) << std::endl;
+            return false;
+        }
+    } else if ((!endsWith(output, ".png") && !endsWith(output, ".ppm")) || !isFramePattern(output)) {
+        std::cerr << "Export pattern needs one integer frame number such as %05d and a .png or .ppm extension "
+                     "(frame_%05d.png), "
+                     "or a '|command' to pipe to: " << output << std::endl;
+        return false;
+    }
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+    glGenRenderbuffers(1, &colorRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+
+    glGenRenderbuffers(1, &depthRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Offscreen framebuffer is incomplete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return false;
+    }
+
+    // RGBA matches the framebuffer, so readback is a straight copy into the buffer
+    glGenBuffers(PBO_COUNT, pbos);
+    for (unsigned int pbo : pbos) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    writer = std::thread(&FrameExporter::writerLoop, this);
+    return true;
+}
+
+void FrameExporter::bind() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+}
+
+void FrameExporter::capture()
+{
+    // Reuse the oldest buffer only once its frame has been collected
+    if (issued - collected == PBO_COUNT) collect();
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[issued % PBO_COUNT]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    ++issued;
+}
+
+bool FrameExporter::finish()
+{
+    while (collected < issued) collect();
+
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            closing = true;
+        }
+        queueChanged.notify_all();
+        writer.join();
+    }
+    if (pipe) {
+        if (pclose(pipe) != 0) failed = true;
+        pipe = nullptr;
+    }
+    return !failed;
+}
+
+void FrameExporter::collect()
+{
+    Frame frame{collected, std::vector<uint8_t>((size_t)width * height * 4)};
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[collected % PBO_COUNT]);
+    const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)frame.rgba.size(), GL_MAP_READ_BIT);
+    if (pixels) {
+        std::memcpy(frame.rgba.data(), pixels, frame.rgba.size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    ++collected;
+
+    // Only a writer far behind holds up rendering, which bounds the memory queued frames take
+    std::unique_lock<std::mutex> lock(queueMutex);
+    queueChanged.wait(lock, [this] { return (int)queue.size() < MAX_QUEUED; });
+    queue.push_back(std::move(frame));
+    lock.unlock();
+    queueChanged.notify_all();
+}
+
+void FrameExporter::writerLoop()
+{
+    while (true) {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        queueChanged.wait(lock, [this] { return closing || !queue.empty(); });
+        if (queue.empty()) return;
+        Frame frame = std::move(queue.front());
+        queue.pop_front();
+        lock.unlock();
+        queueChanged.notify_all();
+
+        if (!writeFrame(frame)) failed = true;
+    }
+}
+
+bool FrameExporter::writeFrame(const Frame& frame)
+{
+    // Flip to top-down rows and drop alpha
+    std::vector<uint8_t> rgb((size_t)width * height * 3);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* src = &frame.rgba[(size_t)(height - 1 - y) * width * 4];
+        uint8_t* dst = &rgb[(size_t)y * width * 3];
+        for (int x = 0; x < width; ++x) {
+            dst[x * 3 + 0] = src[x * 4 + 0];
+            dst[x * 3 + 1] = src[x * 4 + 1];
+            dst[x * 3 + 2] = src[x * 4 + 2];
+        }
+    }
+
+    if (pipe) {
+        return fwrite(rgb.data(), 1, rgb.size(), pipe) == rgb.size();
+    }
+
+    char path[4096];
+    std::snprintf(path, sizeof(path), output.c_str(), frame.index);
+    return endsWith(output, ".png") ? writePng(path, width, height, rgb.data())
+                                    : writePpm(path, width, height, rgb.data());
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class FrameExporter
+{
+public:
+    static constexpr int PBO_COUNT = 3;         // Readbacks in flight before the oldest is collected
+    static constexpr int MAX_QUEUED = 16;       // Frames waiting for the writer before capture blocks
+
+    /// \brief Renders into an offscreen framebuffer and writes frames on a background thread
+    FrameExporter();
+    ~FrameExporter();
+
+    /// \brief Create the framebuffer, readback buffers and writer
+    /// \param width Frame width
+    /// \param height Frame height
+    /// \param output printf pattern for the frame number ending in .png or .ppm (frame_%05d.png),
+    ///               or "|command" to pipe raw RGB24 frames to an encoder's stdin
+    bool initialize(int width, int height, const std::string& output);
+
+    /// \brief Direct rendering into the offscreen framebuffer
+    void bind() const;
+
+    /// \brief Start reading back the frame just rendered, without waiting for the GPU or disk
+    void capture();
+
+    /// \brief Collect every outstanding readback and wait for the writer to finish
+    /// \return False if any frame failed to write
+    bool finish();
+
+private:
+    struct Frame
+    {
+        int index;
+        std::vector<uint8_t> rgba;              // Bottom-up rows, as read back
+    };
+
+    int width, height;
+    std::string output;
+    FILE* pipe;                                 // Encoder process, when piping
+
+    unsigned int fbo, colorRBO, depthRBO;
+    unsigned int pbos[PBO_COUNT];
+    int issued;                                 // Readbacks started
+    int collected;                              // Readbacks mapped and queued
+
+    std::thread writer;
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    std::deque<Frame> queue;
+    bool closing;
+    bool failed;
+
+    // Map the oldest readback and hand its pixels to the writer
+    void collect();
+
+    // Write queued frames until closed
+    void writerLoop();
+    bool writeFrame(const Frame& frame);
+};
@@ -0,0 +1,98 @@
+#include "LodPyramid.hpp"
+#include <algorithm>
+#include <array>
+
+static_assert(Grid::BRICK == (1 << (LodPyramid::LEVELS - 1)),
+              "The coarsest level must map one cell to one brick");
+
+LodPyramid::LodPyramid() : gridSize(0), seenRevision(0) {}
+
+void LodPyramid::update(const Grid& grid)
+{
+    // A differently sized grid starts the pyramid over
+    if (grid.getSize() != gridSize) {
+        gridSize = grid.getSize();
+        seenRevision = 0;
+        for (int level = 1; level < LEVELS; ++level) {
+            levels[level].assign(size(level) * size(level) * size(level), Material::EMPTY);
+        }
+    }
+    if (grid.getRevision() == seenRevision) return;
+
+    const auto& revisions = grid.getBrickRevisions();
+    const int bricks = grid.getBricks();
+    for (int bz = 0; bz < bricks; ++bz)
+    for (int by = 0; by < bricks; ++by)
+    for (int bx = 0; bx < bricks; ++bx)
+    {
+        if (revisions[grid.brickIndex(bx, by, bz)] > seenRevision) {
+            updateBrick(grid, bx, by, bz);
+        }
+    }
+    seenRevision = grid.getRevision();
+}
+
+Material LodPyramid::get(int level, int x, int y, int z) const
+{
+    int n = size(level);
+    return levels[level][(z * n + y) * n + x];
+}
+
+void LodPyramid::updateBrick(const Grid& grid, int bx, int by, int bz)
+{
+    using Counts = std::array<int, (int)Material::COUNT>;
+    constexpr int B = Grid::BRICK;
+
+    // Material histograms for every coarse cell inside the brick, finest first, in units of a full water cell's
+    // mass so partly filled water counts for only the volume it fills
+    std::array<Counts, 4 * 4 * 4> counts1{};
+    std::array<Counts, 2 * 2 * 2> counts2{};
+    Counts counts3{};
+
+    const auto& buffer = grid.getCurrentBuffer();
+    const auto& mass = grid.getMassBuffer();
+    for (int z = 0; z < B; ++z) {
+        for (int y = 0; y < B; ++y) {
+            for (int x = 0; x < B; ++x) {
+                int i = grid.index(bx * B + x, by * B + y, bz * B + z);
+                Material m = buffer[i];
+                // Walls are never drawn, so they count as empty space
+                if (m == Material::EMPTY || m == Material::WALL) continue;
+
+                int c = (int)m;
+                int volume = (m == Material::WATER) ? std::min<int>(mass[i], Grid::FULL_MASS) : Grid::FULL_MASS;
+                counts1[((z >> 1) * 4 + (y >> 1)) * 4 + (x >> 1)][c] += volume;
+                counts2[((z >> 2) * 2 + (y >> 2)) * 2 + (x >> 2)][c] += volume;
+                counts3[c] += volume;
+            }
+        }
+    }
+
+    // A coarse cell is solid when at least half its volume is, taking the commonest material
+    auto majority = [](const Counts& c, int cells) {
+        int occupied = 0;
+        int best = 0;
+        for (int m = 1; m < (int)Material::COUNT; ++m) {
+            occupied += c[m];
+            if (c[m] > c[best]) best = m;
+        }
+        return occupied * 2 >= cells * Grid::FULL_MASS ? (Material)best : Material::EMPTY;
+    };
+
+    for (int level = 1; level < LEVELS; ++level) {
+        int n = B >> level;     // Coarse cells per brick edge at this level
+        int cells = 1 << (3 * level);
+        for (int z = 0; z < n; ++z) {
+            for (int y = 0; y < n; ++y) {
+                for (int x = 0; x < n; ++x) {
+                    const Counts& c = (level == 1) ? counts1[(z * 4 + y) * 4 + x]
+                                    : (level == 2) ? counts2[(z * 2 + y) * 2 + x]
+                                    : counts3;
+                    int s = size(level);
+                    int gx = bx * n + x, gy = by * n + y, gz = bz * n + z;
+                    levels[level][(gz * s + gy) * s + gx] = majority(c, cells);
+                }
+            }
+        }
+    }
+}
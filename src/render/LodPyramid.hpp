@@ -0,0 +1,40 @@
+#pragma once
+
+#include "../sim/Grid.hpp"
+#include <cstdint>
+#include <vector>
+
+class LodPyramid
+{
+public:
+    static constexpr int LEVELS = 4;    // Level 0 is the grid itself, then 2x, 4x and 8x
+
+    /// \brief Downsampled copies of the grid for drawing distant voxels
+    LodPyramid();
+
+    /// \brief Refresh the coarse levels of every brick changed since the last update
+    /// \param grid Voxel grid to downsample
+    void update(const Grid& grid);
+
+    /// \brief Forget the levels, so the next update rebuilds them whole
+    /// Needed once the grid is replaced, since its revisions start over
+    void reset() { gridSize = 0; }
+
+    /// \brief Get the majority material of a coarse cell
+    /// \param level Pyramid level, 1 to LEVELS - 1
+    /// \param x X-coord at that level
+    /// \param y Y-coord at that level
+    /// \param z Z-coord at that level
+    Material get(int level, int x, int y, int z) const;
+
+    /// \brief Get the edge length of a level in cells
+    int size(int level) const { return gridSize >> level; }
+
+private:
+    std::vector<Material> levels[LEVELS];   // Coarse levels, index 0 unused
+    int gridSize;                           // Edge length of the grid the levels were built from
+    uint64_t seenRevision;                  // Grid revision the levels reflect
+
+    // Downsample one brick into every coarse level
+    void updateBrick(const Grid& grid, int bx, int by, int bz);
+};
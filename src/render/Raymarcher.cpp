@@ -0,0 +1,156 @@
+#include "Raymarcher.hpp"
+#include "UniformBlocks.hpp"
+#include <algorithm>
+#include <glad/glad.h>
+#include <string>
+
+// Constructor and destructor
+Raymarcher::Raymarcher() : emptyVAO(0), cellTexture(0), brickTexture(0), gridSizeUniform(-1), gridSize(0),
+                           uploadedRevision(0) {}
+
+Raymarcher::~Raymarcher()
+{
+    if (emptyVAO) glDeleteVertexArrays(1, &emptyVAO);
+    if (cellTexture) glDeleteTextures(1, &cellTexture);
+    if (brickTexture) glDeleteTextures(1, &brickTexture);
+}
+
+// Compile shaders and allocate textures
+bool Raymarcher::initialize()
+{
+    if (!shader.compile("shaders/raymarch.vert", "shaders/raymarch.frag")) {
+        return false;
+    }
+    shader.bindBlock("Camera", UniformBlocks::CAMERA);
+    shader.bindBlock("Palette", UniformBlocks::PALETTE);
+
+    glGenVertexArrays(1, &emptyVAO);
+
+    // Integer textures must be sampled with nearest filtering
+    for (unsigned int* texture : {&cellTexture, &brickTexture}) {
+        glGenTextures(1, texture);
+        glBindTexture(GL_TEXTURE_3D, *texture);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    setupProgram();
+    return true;
+}
+
+// Set the samplers and brick size once per program, and look up the per-frame uniform
+void Raymarcher::setupProgram()
+{
+    shader.use();
+    shader.setInt("cells", 0);
+    shader.setInt("bricks", 1);
+    shader.setInt("brickSize", Grid::BRICK);
+    gridSizeUniform = shader.getUniform("gridSize");
+}
+
+// Rebuild the program if one of its sources changed
+void Raymarcher::reloadShaders(const std::vector<std::string>& changed)
+{
+    for (const std::string& path : changed) {
+        if (shader.usesFile(path)) {
+            if (shader.reload()) setupProgram();
+            return;
+        }
+    }
+}
+
+// Size both textures for the grid
+void Raymarcher::allocate(const Grid& grid)
+{
+    gridSize = grid.getSize();
+    uploadedRevision = 0;
+    brickOccupancy.assign(grid.getBricks() * grid.getBricks() * grid.getBricks(), 0);
+
+    glBindTexture(GL_TEXTURE_3D, cellTexture);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R8UI, gridSize, gridSize, gridSize, 0,
+                 GL_RED_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_3D, brickTexture);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R8UI, grid.getBricks(), grid.getBricks(), grid.getBricks(), 0,
+                 GL_RED_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+// Copy changed bricks into the cell texture and refresh brick occupancy
+void Raymarcher::uploadBricks(const Grid& grid)
+{
+    if (grid.getSize() != gridSize) allocate(grid);
+    if (grid.getRevision() == uploadedRevision) return;
+
+    constexpr int B = Grid::BRICK;
+    uint8_t staging[B * B * B];
+    const auto& buffer = grid.getCurrentBuffer();
+    const auto& mass = grid.getMassBuffer();
+    const auto& revisions = grid.getBrickRevisions();
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_3D, cellTexture);
+    const int bricks = grid.getBricks();
+    for (int bz = 0; bz < bricks; ++bz)
+    for (int by = 0; by < bricks; ++by)
+    for (int bx = 0; bx < bricks; ++bx)
+    {
+        int b = grid.brickIndex(bx, by, bz);
+        if (revisions[b] <= uploadedRevision) continue;
+
+        uint8_t occupied = 0;
+        int i = 0;
+        for (int z = 0; z < B; ++z) {
+            for (int y = 0; y < B; ++y) {
+                for (int x = 0; x < B; ++x, ++i) {
+                    int c = grid.index(bx * B + x, by * B + y, bz * B + z);
+                    Material m = buffer[c];
+                    // Walls are never drawn, so the shader sees them as empty
+                    staging[i] = (m == Material::WALL) ? 0 : (uint8_t)m;
+                    if (m == Material::WATER) {
+                        // Water below full mass carries its fill in 32nds above the material, rounded up
+                        int fill = (std::min<int>(mass[c], Grid::FULL_MASS) * 32 + Grid::FULL_MASS - 1) / Grid::FULL_MASS;
+                        if (fill < 32) staging[i] |= (uint8_t)(std::max(fill, 1) << 3);
+                    }
+                    occupied |= staging[i];
+                }
+            }
+        }
+        brickOccupancy[b] = occupied ? 1 : 0;
+        glTexSubImage3D(GL_TEXTURE_3D, 0, bx * B, by * B, bz * B, B, B, B,
+                        GL_RED_INTEGER, GL_UNSIGNED_BYTE, staging);
+    }
+
+    // The brick level is tiny, so resend it whole
+    glBindTexture(GL_TEXTURE_3D, brickTexture);
+    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, bricks, bricks, bricks,
+                    GL_RED_INTEGER, GL_UNSIGNED_BYTE, brickOccupancy.data());
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    uploadedRevision = grid.getRevision();
+}
+
+// Raymarch the grid from the camera in the Camera block
+void Raymarcher::render(const Grid& grid)
+{
+    uploadBricks(grid);
+
+    shader.use();
+    shader.setInt(gridSizeUniform, grid.getSize());
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_3D, cellTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_3D, brickTexture);
+
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glBindTexture(GL_TEXTURE_3D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_3D, 0);
+}
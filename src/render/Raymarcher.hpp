@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../sim/Grid.hpp"
+#include "../utils/Shader.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Raymarcher
+{
+public:
+    /// \brief Renders the grid by raymarching a 3D texture of it in the fragment shader
+    Raymarcher();
+    ~Raymarcher();
+
+    /// \brief Compile the raymarch shader and allocate the grid textures
+    bool initialize();
+
+    /// \brief Draw the grid as a full-screen pass, from the camera in the shared Camera block
+    /// \param grid Voxel grid
+    void render(const Grid& grid);
+
+    /// \brief Rebuild the raymarch shader if any of the changed files is one of its sources
+    /// \param changed Paths of files written since the last call
+    void reloadShaders(const std::vector<std::string>& changed);
+
+    /// \brief Forget the uploaded cells, so the next render uploads the grid whole
+    /// Needed once the grid is replaced, since its revisions start over
+    void reset() { gridSize = 0; }
+
+private:
+    unsigned int emptyVAO;          // Full-screen triangle needs no vertex data
+    unsigned int cellTexture;       // R8UI material per cell in the low 3 bits, water fill in 32nds above, 0 when full
+    unsigned int brickTexture;      // R8UI per brick, nonzero when it holds drawable voxels
+    Shader shader;
+    int gridSizeUniform;            // Location of the one uniform set every frame
+
+    int gridSize;                   // Edge length the textures were allocated for
+    uint64_t uploadedRevision;      // Grid revision the textures reflect
+    std::vector<uint8_t> brickOccupancy;
+
+    // Set the uniforms that stay fixed for the program's lifetime
+    void setupProgram();
+
+    // Size the textures for a grid, forcing a full upload
+    void allocate(const Grid& grid);
+
+    // Upload every brick changed since the last upload
+    void uploadBricks(const Grid& grid);
+};
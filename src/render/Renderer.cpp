@@ -1,12 +1,60 @@
 #include "Renderer.hpp"
+#include "UniformBlocks.hpp"
 #include <glad/glad.h>
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
 #include <vector>
 #include <iostream>
 
+namespace {
+    // Cube faces in -Z, +Z, -X, +X, -Y, +Y order, each with in-plane axes where u x v is the normal
+    const glm::ivec3 FACE_NORMAL[6] = {{0, 0, -1}, {0, 0, 1}, {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}};
+    const glm::ivec3 FACE_U[6] = {{0, 1, 0}, {1, 0, 0}, {0, 0, 1}, {0, 1, 0}, {1, 0, 0}, {0, 0, 1}};
+    const glm::ivec3 FACE_V[6] = {{1, 0, 0}, {0, 1, 0}, {0, 1, 0}, {0, 0, 1}, {0, 0, 1}, {1, 0, 0}};
+
+    // Corners of a face along u and v, counter-clockwise seen from outside the cube
+    const glm::ivec2 CORNER[4] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+
+    // Height of the water in a cell, compressed cells drawing full
+    float waterFill(uint8_t mass)
+    {
+        return std::min((float)mass / Grid::FULL_MASS, 1.0f);
+    }
+
+    // Bit of a neighbour in a 3x3x3 occupancy mask around a cell
+    int neighbourBit(const glm::ivec3& d)
+    {
+        return (d.x + 1) + (d.y + 1) * 3 + (d.z + 1) * 9;
+    }
+
+    // Two bits per face corner counting the drawn cells that shade it, corner f * 4 + c of the cube
+    glm::uvec2 packOcclusion(uint32_t neighbours)
+    {
+        glm::uvec2 packed(0u);
+        for (int f = 0; f < 6; ++f) {
+            for (int c = 0; c < 4; ++c) {
+                glm::ivec3 side1 = FACE_NORMAL[f] + CORNER[c].x * FACE_U[f];
+                glm::ivec3 side2 = FACE_NORMAL[f] + CORNER[c].y * FACE_V[f];
+                uint32_t a = (neighbours >> neighbourBit(side1)) & 1u;
+                uint32_t b = (neighbours >> neighbourBit(side2)) & 1u;
+                uint32_t diagonal = (neighbours >> neighbourBit(side1 + CORNER[c].y * FACE_V[f])) & 1u;
+
+                // Both sides drawn hide the corner completely, whatever is diagonal to it
+                uint32_t occlusion = (a && b) ? 3u : a + b + diagonal;
+                int slot = f * 4 + c;
+                packed[slot >> 4] |= occlusion << ((slot & 15) * 2);
+            }
+        }
+        return packed;
+    }
+}
+
 // Constructor and destructor
 Renderer::Renderer() : cubeVAO(0), cubeVBO(0), instanceVAO(0),
-                       instancePosVBO(0), instanceColorVBO(0) {}
+                       instancePosVBO(0), instanceColorVBO(0), instanceScaleVBO(0), instanceOcclusionVBO(0),
+                       mode(RenderMode::INSTANCED), viewportHeight(800), instanceCount(0), instanceCapacity(10000),
+                       uploadedRevision(UINT64_MAX) {}
 
 Renderer::~Renderer()
 {
@@ -15,6 +63,18 @@ Renderer::~Renderer()
     if (instanceVAO) glDeleteVertexArrays(1, &instanceVAO);
     if (instancePosVBO) glDeleteBuffers(1, &instancePosVBO);
     if (instanceColorVBO) glDeleteBuffers(1, &instanceColorVBO);
+    if (instanceScaleVBO) glDeleteBuffers(1, &instanceScaleVBO);
+    if (instanceOcclusionVBO) glDeleteBuffers(1, &instanceOcclusionVBO);
+}
+
+// A replaced grid's revisions start over, so every cache keyed on them is rebuilt
+void Renderer::reset()
+{
+    lod.reset();
+    raymarcher.reset();
+    brickLevels.clear();
+    brickStart.clear();
+    uploadedRevision = UINT64_MAX;
 }
 
 // Initialize shaders and voxel render grid
@@ -23,6 +83,19 @@ bool Renderer::initialize()
     if (!shader.compile("shaders/voxel.vert", "shaders/voxel.frag")) {
         return false;
     }
+    shader.bindBlock("Camera", UniformBlocks::CAMERA);
+    if (!raymarcher.initialize()) {
+        return false;
+    }
+
+    // Camera constants are written once per frame for every pass, the palette only here
+    cameraBuffer.create(sizeof(CameraBlock), UniformBlocks::CAMERA);
+    paletteBuffer.create(sizeof(PaletteBlock), UniformBlocks::PALETTE);
+    PaletteBlock palette;
+    for (int m = 0; m < (int)Material::COUNT; ++m) {
+        palette.colors[m] = glm::vec4(getMaterialInfo((Material)m).color, 1.0f);
+    }
+    paletteBuffer.update(&palette);
 
     setupCube();
     return true;
@@ -31,22 +104,25 @@ bool Renderer::initialize()
 // Setup voxel render grid
 void Renderer::setupCube()
 {
-    // Unit cube vertices
-    float vertices[] = {
-        -0.5f, -0.5f, -0.5f, 0.5f, -0.5f, -0.5f,
-        0.5f,  0.5f,  -0.5f, -0.5f, 0.5f, -0.5f,
-        -0.5f, -0.5f, 0.5f,  0.5f, -0.5f, 0.5f,
-        0.5f,  0.5f,  0.5f,  -0.5f, 0.5f, 0.5f
-    };
-
-    unsigned int indices[] = {
-        0, 1, 2, 2, 3, 0,
-        4, 6, 5, 6, 4, 7,
-        0, 4, 5, 5, 1, 0,
-        2, 6, 7, 7, 3, 2,
-        0, 3, 7, 7, 4, 0,
-        1, 5, 6, 6, 2, 1
-    };
+    // Unit cube with four vertices per face, so each carries its face's normal
+    float vertices[24 * 6];
+    unsigned int indices[36];
+    for (int f = 0; f < 6; ++f) {
+        for (int c = 0; c < 4; ++c) {
+            glm::vec3 position = 0.5f * glm::vec3(FACE_NORMAL[f] + CORNER[c].x * FACE_U[f] + CORNER[c].y * FACE_V[f]);
+            float* vertex = &vertices[(f * 4 + c) * 6];
+            vertex[0] = position.x;
+            vertex[1] = position.y;
+            vertex[2] = position.z;
+            vertex[3] = (float)FACE_NORMAL[f].x;
+            vertex[4] = (float)FACE_NORMAL[f].y;
+            vertex[5] = (float)FACE_NORMAL[f].z;
+        }
+        const unsigned int quad[6] = {0, 1, 2, 2, 3, 0};
+        for (int i = 0; i < 6; ++i) {
+            indices[f * 6 + i] = f * 4 + quad[i];
+        }
+    }
 
     unsigned int EBO;
     glGenVertexArrays(1, &cubeVAO);
@@ -54,6 +130,8 @@ void Renderer::setupCube()
     glGenBuffers(1, &EBO);
     glGenBuffers(1, &instancePosVBO);
     glGenBuffers(1, &instanceColorVBO);
+    glGenBuffers(1, &instanceScaleVBO);
+    glGenBuffers(1, &instanceOcclusionVBO);
 
     glBindVertexArray(cubeVAO);
     glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
@@ -62,81 +140,364 @@ void Renderer::setupCube()
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
+    // Normal attribute
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(4);
+
     // Position attribute
     glBindBuffer(GL_ARRAY_BUFFER, instancePosVBO);
-    glBufferData(GL_ARRAY_BUFFER, 10000 * sizeof(glm::vec3), nullptr, GL_DYNAMIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(glm::vec3), nullptr, GL_DYNAMIC_DRAW);
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(1);
     glVertexAttribDivisor(1, 1);
 
     // Color attribute
     glBindBuffer(GL_ARRAY_BUFFER, instanceColorVBO);
-    glBufferData(GL_ARRAY_BUFFER, 10000 * sizeof(glm::vec3), nullptr, GL_DYNAMIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(glm::vec3), nullptr, GL_DYNAMIC_DRAW);
     glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(2);
     glVertexAttribDivisor(2, 1);
 
+    // Scale attribute per axis, larger than one for coarse pyramid cells and shorter for partly filled water
+    glBindBuffer(GL_ARRAY_BUFFER, instanceScaleVBO);
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(glm::vec3), nullptr, GL_DYNAMIC_DRAW);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+
+    // Ambient occlusion attribute, two bits per face corner
+    glBindBuffer(GL_ARRAY_BUFFER, instanceOcclusionVBO);
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(glm::uvec2), nullptr, GL_DYNAMIC_DRAW);
+    glVertexAttribIPointer(5, 2, GL_UNSIGNED_INT, sizeof(glm::uvec2), (void*)0);
+    glEnableVertexAttribArray(5);
+    glVertexAttribDivisor(5, 1);
+
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 }
 
+// Pick the coarsest level per brick whose cubes still cover LOD_PIXELS on screen
+std::vector<uint8_t> Renderer::selectLevels(const Grid& grid, const Camera& camera) const
+{
+    const int bricks = grid.getBricks();
+    std::vector<uint8_t> levels(bricks * bricks * bricks, 0);
+
+    glm::vec3 eye = camera.getPosition();
+    float pixelsAtUnitDist = viewportHeight / (2.0f * std::tan(glm::radians(camera.getFov()) * 0.5f));
+    int i = 0;
+    for (int bz = 0; bz < bricks; ++bz) {
+        for (int by = 0; by < bricks; ++by) {
+            for (int bx = 0; bx < bricks; ++bx, ++i) {
+                glm::vec3 center = (glm::vec3((float)bx, (float)by, (float)bz) + 0.5f) * (float)Grid::BRICK;
+                float dist = std::max(glm::length(center - eye), 1e-3f);
+                float voxelPixels = pixelsAtUnitDist / dist;
+
+                int level = 0;
+                while (level < LodPyramid::LEVELS - 1 && (1 << level) * voxelPixels < LOD_PIXELS) {
+                    ++level;
+                }
+                levels[i] = (uint8_t)level;
+            }
+        }
+    }
+    return levels;
+}
+
+void Renderer::Instances::append(const Instances& from, int begin, int end)
+{
+    positions.insert(positions.end(), from.positions.begin() + begin, from.positions.begin() + end);
+    colors.insert(colors.end(), from.colors.begin() + begin, from.colors.begin() + end);
+    scales.insert(scales.end(), from.scales.begin() + begin, from.scales.begin() + end);
+    occlusions.insert(occlusions.end(), from.occlusions.begin() + begin, from.occlusions.begin() + end);
+    cells.insert(cells.end(), from.cells.begin() + begin, from.cells.begin() + end);
+}
+
+void Renderer::Instances::write(int offset, const Instances& from)
+{
+    std::copy(from.positions.begin(), from.positions.end(), positions.begin() + offset);
+    std::copy(from.colors.begin(), from.colors.end(), colors.begin() + offset);
+    std::copy(from.scales.begin(), from.scales.end(), scales.begin() + offset);
+    std::copy(from.occlusions.begin(), from.occlusions.end(), occlusions.begin() + offset);
+    std::copy(from.cells.begin(), from.cells.end(), cells.begin() + offset);
+}
+
 // Update OpenGL buffers
-void Renderer::updateInstanceData(const Grid& grid)
+void Renderer::updateInstanceData(const Grid& grid, const Camera& camera)
+{
+    // Settled grids keep their uploaded instances until the camera moves a brick to another level
+    std::vector<uint8_t> levels = selectLevels(grid, camera);
+    if (grid.getRevision() == uploadedRevision && levels == brickLevels) return;
+    lod.update(grid);
+
+    // Changed bricks and those drawn from another level are rebuilt. Their untouched neighbours only rebake
+    // the occlusion of the border cells the changes shade
+    const int bricks = grid.getBricks();
+    const int brickCount = (int)levels.size();
+    const auto& revisions = grid.getBrickRevisions();
+    const bool whole = (int)brickLevels.size() != brickCount;
+    std::vector<uint8_t> rebuild(brickCount, whole ? 1 : 0);
+    std::vector<uint32_t> shade(brickCount, 0);        // Changed neighbours of each brick, by neighbourBit
+    if (!whole) {
+        for (int bz = 0; bz < bricks; ++bz)
+        for (int by = 0; by < bricks; ++by)
+        for (int bx = 0; bx < bricks; ++bx)
+        {
+            int b = grid.brickIndex(bx, by, bz);
+            if (levels[b] != brickLevels[b]) rebuild[b] = 1;
+            if (revisions[b] <= uploadedRevision) continue;
+            rebuild[b] = 1;
+            for (int nz = std::max(bz - 1, 0); nz <= std::min(bz + 1, bricks - 1); ++nz)
+            for (int ny = std::max(by - 1, 0); ny <= std::min(by + 1, bricks - 1); ++ny)
+            for (int nx = std::max(bx - 1, 0); nx <= std::min(bx + 1, bricks - 1); ++nx)
+            {
+                shade[grid.brickIndex(nx, ny, nz)] |= 1u << neighbourBit(glm::ivec3(bx - nx, by - ny, bz - nz));
+            }
+        }
+    } else {
+        instances.clear();
+        brickStart.assign(brickCount + 1, 0);
+    }
+    uploadedRevision = grid.getRevision();
+    brickLevels = levels;
+
+    // Instance ranges to upload, merged where they touch
+    std::vector<glm::ivec2> ranges;         // Every attribute
+    std::vector<glm::ivec2> shaded;         // Occlusion alone
+    auto upload = [](std::vector<glm::ivec2>& list, int begin, int end) {
+        if (begin == end) return;
+        if (!list.empty() && list.back().y == begin) list.back().y = end;
+        else list.push_back(glm::ivec2(begin, end));
+    };
+
+    // Rebuilt bricks keeping their voxel count are written in place. From the first one that grows or shrinks
+    // on, every later brick moves, so the rest of the buffers is reassembled behind it
+    Instances built;
+    Instances tail;
+    int tailStart = -1;                     // First instance of the reassembled part, -1 while nothing moved
+    int b = 0;
+    for (int bz = 0; bz < bricks; ++bz)
+    for (int by = 0; by < bricks; ++by)
+    for (int bx = 0; bx < bricks; ++bx, ++b)
+    {
+        int begin = brickStart[b];
+        int end = brickStart[b + 1];
+        if (rebuild[b]) {
+            built.clear();
+            buildBrick(grid, bx, by, bz, levels[b], built);
+        }
+
+        if (tailStart < 0) {
+            if (!rebuild[b]) continue;
+            if (built.size() == end - begin) {
+                instances.write(begin, built);
+                upload(ranges, begin, end);
+                continue;
+            }
+            tailStart = begin;
+        }
+
+        brickStart[b] = tailStart + tail.size();
+        if (rebuild[b]) tail.append(built, 0, built.size());
+        else tail.append(instances, begin, end);
+    }
+    if (tailStart >= 0) {
+        instances.resize(tailStart);
+        instances.append(tail, 0, tail.size());
+        brickStart[brickCount] = instances.size();
+        upload(ranges, tailStart, instances.size());
+    }
+    instanceCount = instances.size();
+
+    // Reassembled bricks are uploaded whole already
+    for (b = 0; b < brickCount; ++b) {
+        if (rebuild[b] || !shade[b] || !reshadeBrick(grid, b, levels[b], shade[b])) continue;
+        if (tailStart < 0 || brickStart[b] < tailStart) upload(shaded, brickStart[b], brickStart[b + 1]);
+    }
+
+    // Grow the instance buffers when the voxel count outgrows them, sending everything again
+    if (instanceCount > instanceCapacity) {
+        instanceCapacity = instanceCount * 2;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, instancePosVBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, instanceCapacity * sizeof(glm::vec3), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, instanceColorVBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, instanceCapacity * sizeof(glm::vec3), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, instanceScaleVBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, instanceCapacity * sizeof(glm::vec3), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, instanceOcclusionVBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, instanceCapacity * sizeof(glm::uvec2), nullptr, GL_DYNAMIC_DRAW);
+        ranges.assign(1, glm::ivec2(0, instanceCount));
+        shaded.clear();
+    }
+
+    for (const glm::ivec2& r : ranges) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, instancePosVBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, r.x * sizeof(glm::vec3), (r.y - r.x) * sizeof(glm::vec3),
+                        instances.positions.data() + r.x);
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, instanceColorVBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, r.x * sizeof(glm::vec3), (r.y - r.x) * sizeof(glm::vec3),
+                        instances.colors.data() + r.x);
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, instanceScaleVBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, r.x * sizeof(glm::vec3), (r.y - r.x) * sizeof(glm::vec3),
+                        instances.scales.data() + r.x);
+    }
+
+    ranges.insert(ranges.end(), shaded.begin(), shaded.end());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, instanceOcclusionVBO);
+    for (const glm::ivec2& r : ranges) {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, r.x * sizeof(glm::uvec2), (r.y - r.x) * sizeof(glm::uvec2),
+                        instances.occlusions.data() + r.x);
+    }
+}
+
+bool Renderer::drawn(const Grid& grid, int level, int x, int y, int z) const
 {
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec3> colors;
+    int n = (level == 0) ? grid.getSize() : lod.size(level);
+    if (x < 0 || y < 0 || z < 0 || x >= n || y >= n || z >= n) return false;
+    Material m = (level == 0) ? grid.getCurrentBuffer()[grid.index(x, y, z)] : lod.get(level, x, y, z);
+    return m != Material::EMPTY && m != Material::WALL;
+}
 
+void Renderer::buildBrick(const Grid& grid, int bx, int by, int bz, int level, Instances& out) const
+{
     const auto& buffer = grid.getCurrentBuffer();
-    for (int z = 1; z < Grid::SIZE - 1; ++z) {
-        for (int y = 1; y < Grid::SIZE - 1; ++y) {
-            for (int x = 1; x < Grid::SIZE - 1; ++x) {
-                Material m = buffer[grid.index(x, y, z)];
-                if (m != Material::EMPTY && m != Material::WALL) {
-                    positions.push_back(glm::vec3(x, y, z));
-                    colors.push_back(getMaterialInfo(m).color);
+    const auto& mass = grid.getMassBuffer();
+    const int n = Grid::BRICK >> level;     // Cells per brick edge at this level
+    const glm::ivec3 origin = glm::ivec3(bx, by, bz) * n;
+
+    // Which cells of the brick and the layer around it are drawn, so each neighbour is looked up once
+    constexpr int P = Grid::BRICK + 2;
+    uint8_t occupied[P * P * P];
+    const int p = n + 2;
+    auto at = [p](int x, int y, int z) { return ((z + 1) * p + y + 1) * p + x + 1; };
+    for (int z = -1; z <= n; ++z)
+    for (int y = -1; y <= n; ++y)
+    for (int x = -1; x <= n; ++x)
+    {
+        occupied[at(x, y, z)] = drawn(grid, level, origin.x + x, origin.y + y, origin.z + z) ? 1 : 0;
+    }
+
+    float scale = (float)(1 << level);
+    float offset = (scale - 1.0f) * 0.5f;
+    for (int z = 0; z < n; ++z) {
+        for (int y = 0; y < n; ++y) {
+            for (int x = 0; x < n; ++x) {
+                if (!occupied[at(x, y, z)]) continue;
+
+                uint32_t neighbours = 0;
+                for (int dz = -1; dz <= 1; ++dz)
+                for (int dy = -1; dy <= 1; ++dy)
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    neighbours |= (uint32_t)occupied[at(x + dx, y + dy, z + dz)] << neighbourBit(glm::ivec3(dx, dy, dz));
+                }
+
+                // Water fills its cell from the bottom up to its mass, so a spread pool keeps its volume
+                glm::ivec3 cell = origin + glm::ivec3(x, y, z);
+                Material m = (level == 0) ? buffer[grid.index(cell.x, cell.y, cell.z)]
+                                          : lod.get(level, cell.x, cell.y, cell.z);
+                glm::vec3 position = glm::vec3(cell) * scale + offset;
+                glm::vec3 size(scale);
+                if (level == 0 && m == Material::WATER) {
+                    size.y = waterFill(mass[grid.index(cell.x, cell.y, cell.z)]);
+                    position.y += (size.y - 1.0f) * 0.5f;
                 }
+                out.positions.push_back(position);
+                out.colors.push_back(getMaterialInfo(m).color);
+                out.scales.push_back(size);
+                out.occlusions.push_back(packOcclusion(neighbours));
+                out.cells.push_back(cell);
             }
         }
     }
+}
 
-    glBindBuffer(GL_COPY_WRITE_BUFFER, instancePosVBO);
-    glBufferSubData(GL_COPY_WRITE_BUFFER, 0, positions.size() * sizeof(glm::vec3), positions.data());
+bool Renderer::reshadeBrick(const Grid& grid, int b, int level, uint32_t changed)
+{
+    const int n = Grid::BRICK >> level;
+    bool any = false;
+    for (int i = brickStart[b]; i < brickStart[b + 1]; ++i) {
+        // Only cells on the brick's faces see into the neighbours, and only those facing a changed one matter
+        const glm::ivec3& cell = instances.cells[i];
+        glm::ivec3 lo(0), hi(0);
+        for (int axis = 0; axis < 3; ++axis) {
+            int local = cell[axis] % n;
+            if (local == 0) lo[axis] = -1;
+            if (local == n - 1) hi[axis] = 1;
+        }
+        bool reached = false;
+        for (int dz = lo.z; dz <= hi.z; ++dz)
+        for (int dy = lo.y; dy <= hi.y; ++dy)
+        for (int dx = lo.x; dx <= hi.x; ++dx)
+        {
+            if ((changed >> neighbourBit(glm::ivec3(dx, dy, dz))) & 1u) reached = true;
+        }
+        if (!reached) continue;
 
-    glBindBuffer(GL_COPY_WRITE_BUFFER, instanceColorVBO);
-    glBufferSubData(GL_COPY_WRITE_BUFFER, 0, colors.size() * sizeof(glm::vec3), colors.data());
+        uint32_t neighbours = 0;
+        for (int dz = -1; dz <= 1; ++dz)
+        for (int dy = -1; dy <= 1; ++dy)
+        for (int dx = -1; dx <= 1; ++dx)
+        {
+            if (drawn(grid, level, cell.x + dx, cell.y + dy, cell.z + dz)) {
+                neighbours |= 1u << neighbourBit(glm::ivec3(dx, dy, dz));
+            }
+        }
+        instances.occlusions[i] = packOcclusion(neighbours);
+        any = true;
+    }
+    return any;
 }
 
 // Render the voxel environment to screen
 void Renderer::render(const Grid& grid, const Camera& camera)
 {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    shader.use();
-    shader.setMat4("projection", camera.getProjectionMatrix());
-    shader.setMat4("view", camera.getViewMatrix());
-    shader.setMat4("model", glm::mat4(1.0f));
-
-    updateInstanceData(grid);
+    CameraBlock block;
+    block.view = camera.getViewMatrix();
+    block.projection = camera.getProjectionMatrix();
+    block.viewProj = block.projection * block.view;
+    block.invViewProj = glm::inverse(block.viewProj);
+    block.position = glm::vec4(camera.getPosition(), 1.0f);
+    cameraBuffer.update(&block);
 
-    const auto& buffer = grid.getCurrentBuffer();
-    int count = 0;
-    for (Material m : buffer) {
-        if (m != Material::EMPTY && m != Material::WALL) count++;
+    if (mode == RenderMode::RAYMARCH) {
+        raymarcher.render(grid);
+        return;
     }
 
-    if (count > 0) {
+    shader.use();
+
+    updateInstanceData(grid, camera);
+
+    if (instanceCount > 0) {
         glBindVertexArray(cubeVAO);
-        glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0, count);
+        glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0, instanceCount);
         glBindVertexArray(0);
     }
 }
 
+// Swap in rebuilt programs for edited shaders
+void Renderer::reloadShaders(const std::vector<std::string>& changed)
+{
+    for (const std::string& path : changed) {
+        if (shader.usesFile(path)) {
+            shader.reload();
+            break;
+        }
+    }
+    raymarcher.reloadShaders(changed);
+}
+
 // Reshape window
 void Renderer::reshape(int width, int height)
 {
+    viewportHeight = height;
     glViewport(0, 0, width, height);
 }
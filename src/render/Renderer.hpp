@@ -3,10 +3,22 @@
 #include <glad/glad.h>
 #include "../sim/Grid.hpp"
 #include "Camera.hpp"
+#include "LodPyramid.hpp"
+#include "Raymarcher.hpp"
 #include "../utils/Shader.hpp"
+#include "../utils/UniformBuffer.hpp"
+#include <cstdint>
+#include <string>
 #include <vector>
 #include <glm/glm.hpp>
 
+/// \brief How the voxel grid is drawn
+enum class RenderMode
+{
+    INSTANCED,      // One cube instance per visible voxel
+    RAYMARCH        // Full-screen raymarch through a 3D texture
+};
+
 class Renderer
 {
 public:
@@ -27,15 +39,82 @@ public:
     /// \param height New window height
     void reshape(int width, int height);
 
+    /// \brief Rebuild any shader program with a changed source, keeping the old one if it fails to build
+    /// \param changed Paths of files written since the last call
+    void reloadShaders(const std::vector<std::string>& changed);
+
+    /// \brief Forget everything drawn from the previous grid, after it was replaced by another
+    void reset();
+
+    /// \brief Switch how the grid is drawn
+    /// \param mode New render mode
+    void setMode(RenderMode mode) { this->mode = mode; }
+
+    /// \brief Get how the grid is drawn
+    RenderMode getMode() const { return mode; }
+
 private:
     // OpenGL variables
     unsigned int cubeVAO, cubeVBO;
-    unsigned int instanceVAO, instancePosVBO, instanceColorVBO;
+    unsigned int instanceVAO, instancePosVBO, instanceColorVBO, instanceScaleVBO;
+    unsigned int instanceOcclusionVBO;      // uvec2 of 2-bit ambient occlusion per cube face corner
     Shader shader;
+    UniformBuffer cameraBuffer;     // CameraBlock, shared by both render modes
+    UniformBuffer paletteBuffer;    // PaletteBlock
+    Raymarcher raymarcher;
+    RenderMode mode;
+
+    static constexpr float LOD_PIXELS = 4.0f;   // Smallest on-screen cube size before coarsening
+    LodPyramid lod;
+    std::vector<uint8_t> brickLevels;           // Pyramid level each brick was drawn from
+    int viewportHeight;
+
+    // Instance attributes of drawn voxels, one entry per voxel
+    struct Instances
+    {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> colors;
+        std::vector<glm::vec3> scales;
+        std::vector<glm::uvec2> occlusions;
+        std::vector<glm::ivec3> cells;      // Cell at the brick's level, kept only to reshade it
+
+        int size() const { return (int)positions.size(); }
+        void clear() { resize(0); }
+        void resize(int n)
+        {
+            positions.resize(n); colors.resize(n); scales.resize(n); occlusions.resize(n); cells.resize(n);
+        }
+
+        // Append voxels [begin, end) of another set
+        void append(const Instances& from, int begin, int end);
+
+        // Overwrite voxels from offset on with all of another set
+        void write(int offset, const Instances& from);
+    };
+
+    Instances instances;            // Copy of the instance buffers, grouped by brick in brickIndex order
+    std::vector<int> brickStart;    // First instance of each brick, one past the last brick ending the buffers
+    int instanceCount;              // Voxels uploaded to the instance buffers
+    int instanceCapacity;           // Voxels the instance buffers can hold
+    uint64_t uploadedRevision;      // Grid revision the instance buffers reflect
 
     // Set up voxel grid
     void setupCube();
 
-    // Update render buffers
-    void updateInstanceData(const Grid& grid);
+    // Update render buffers, rebuilding only the bricks that changed or moved to another level
+    void updateInstanceData(const Grid& grid, const Camera& camera);
+
+    // Build the instances of one brick at a pyramid level, baking their occlusion
+    void buildBrick(const Grid& grid, int bx, int by, int bz, int level, Instances& out) const;
+
+    // Rebake the occlusion of a brick's instances next to changed neighbour bricks
+    // \param changed 3x3x3 mask of the neighbour bricks that changed, by neighbourBit
+    // \return True if any instance was rebaked
+    bool reshadeBrick(const Grid& grid, int b, int level, uint32_t changed);
+
+    // Whether a cell at a pyramid level holds a drawn voxel, cells outside the grid being empty
+    bool drawn(const Grid& grid, int level, int x, int y, int z) const;
+
+    // Choose the pyramid level to draw each brick from
+    std::vector<uint8_t> selectLevels(const Grid& grid, const Camera& camera) const;
 };
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "../sim/Materials.hpp"
+#include <glm/glm.hpp>
+
+/// \brief Binding points of the uniform blocks shared between programs
+namespace UniformBlocks
+{
+    constexpr unsigned int CAMERA = 0;
+    constexpr unsigned int PALETTE = 1;
+}
+
+/// \brief Per-frame camera constants, matching the std140 Camera block in the shaders
+struct CameraBlock
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProj;
+    glm::mat4 invViewProj;
+    glm::vec4 position;         // w unused
+};
+
+/// \brief Material colours indexed by Material, matching the std140 Palette block in the shaders
+struct PaletteBlock
+{
+    glm::vec4 colors[(int)Material::COUNT];     // w unused, std140 pads vec3 array elements anyway
+};
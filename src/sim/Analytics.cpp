@@ -0,0 +1,452 @@
+#include "Analytics.hpp"
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace {
+    constexpr int COUNT = (int)Material::COUNT;
+    constexpr int COLUMNS = Grid::BRICK * Grid::BRICK;     // Columns of cells per brick
+    constexpr int ROWS = COLUMNS;                          // Rows of cells along x per brick
+
+    // The 13 neighbours after a cell in z, y, x order, whose joins together reach all 26
+    constexpr int AFTER[13][3] = {
+        {1, 0, 0},
+        {-1, 1, 0}, {0, 1, 0}, {1, 1, 0},
+        {-1, -1, 1}, {0, -1, 1}, {1, -1, 1}, {-1, 0, 1}, {0, 0, 1}, {1, 0, 1}, {-1, 1, 1}, {0, 1, 1}, {1, 1, 1}
+    };
+
+    // Live cells of a brick's row along x from its first cell, a bit each
+    unsigned liveRow(const CellBuffer& cells, size_t start)
+    {
+        if (cells.isPacked()) {
+            unsigned mask = 0;
+            for (int x = 0; x < Grid::BRICK; ++x) {
+                mask |= (unsigned)(cells[start + x] == Material::GOL) << x;
+            }
+            return mask;
+        }
+
+        // A byte is zero after the xor exactly when adding 0x7F to its low bits leaves its high bit clear,
+        // and the multiply gathers the high bits into the top byte
+        constexpr uint64_t LOW = 0x7F7F7F7F7F7F7F7Full;
+        uint64_t word;
+        std::memcpy(&word, cells.data() + start, sizeof(word));
+        word ^= 0x0101010101010101ull * (uint64_t)Material::GOL;
+        uint64_t zero = ~(((word & LOW) + LOW) | word) & ~LOW;
+        return (unsigned)(((zero >> 7) * 0x0102040810204080ull) >> 56);
+    }
+}
+
+Analytics::Analytics(const Grid& grid, int threads)
+    : size(grid.getSize()),
+      depth(grid.getDepth()),
+      bricks(grid.getBricks()),
+      layers(grid.getDepth() / Grid::BRICK),
+      threads(threads > 0 ? threads : (int)std::max(std::thread::hardware_concurrency(), 1u)),
+      seenRevision(0),
+      brickCounts((size_t)bricks * bricks * layers * COUNT, 0),
+      brickTops((size_t)bricks * bricks * layers * COLUMNS, 0),
+      brickWater((size_t)bricks * bricks * layers, 0),
+      population{},
+      waterSurface(0),
+      labels((size_t)bricks * bricks * layers * ROWS * Grid::BRICK, 0),
+      liveRows((size_t)bricks * bricks * layers * ROWS, 0),
+      clusterSizes((size_t)bricks * bricks * layers),
+      clusterLinks((size_t)bricks * bricks * layers),
+      relabel((size_t)bricks * bricks * layers, 0)
+{
+    if (std::min(this->threads, layers) > 1) pool = std::make_unique<ThreadPool>(this->threads);
+    for (int axis = 0; axis < 3; ++axis) {
+        wrap[axis] = grid.wraps(axis);
+        waterBeyond[axis] = grid.getBoundary(axis) == Boundary::OPEN;
+    }
+}
+
+void Analytics::update(const CellBuffer& cells, const std::vector<uint64_t>& brickRevisions, uint64_t revision)
+{
+    if (revision == seenRevision) return;
+
+    // Exposed water also depends on the cells of the bricks either side, so their changes recount a brick too
+    const glm::ivec3 extent(bricks, bricks, layers);
+    std::vector<uint8_t> recount(brickWater.size(), 0);
+    for (int bz = 0; bz < layers; ++bz)
+    for (int by = 0; by < bricks; ++by)
+    for (int bx = 0; bx < bricks; ++bx)
+    {
+        if (brickRevisions[brickIndex(bx, by, bz)] <= seenRevision) continue;
+        recount[brickIndex(bx, by, bz)] = 1;
+        relabel[brickIndex(bx, by, bz)] = 1;
+        for (int axis = 0; axis < 3; ++axis) {
+            for (int step = -1; step <= 1; step += 2) {
+                glm::ivec3 n(bx, by, bz);
+                n[axis] += step;
+                if (n[axis] < 0 || n[axis] >= extent[axis]) {
+                    if (!wrap[axis]) continue;
+                    n[axis] = (n[axis] + extent[axis]) % extent[axis];
+                }
+                recount[brickIndex(n.x, n.y, n.z)] = 1;
+            }
+        }
+    }
+
+    // Bricks only write their own counters, so slabs of them recount in parallel
+    forEachSlab([&](int, int z0, int z1) {
+        for (int bz = z0 / Grid::BRICK; bz < z1 / Grid::BRICK; ++bz)
+        for (int by = 0; by < bricks; ++by)
+        for (int bx = 0; bx < bricks; ++bx)
+        {
+            if (recount[brickIndex(bx, by, bz)]) countBrick(cells, bx, by, bz);
+        }
+    });
+
+    population.fill(0);
+    waterSurface = 0;
+    for (size_t b = 0; b < brickWater.size(); ++b) {
+        for (int m = 0; m < COUNT; ++m) {
+            population[m] += brickCounts[b * COUNT + m];
+        }
+        waterSurface += brickWater[b];
+    }
+    seenRevision = revision;
+}
+
+void Analytics::measure(const CellBuffer& cells, TickStats& stats)
+{
+    stats.population = population;
+    stats.waterSurface = waterSurface;
+
+    // A column's height is the highest top among the bricks stacked along it
+    int columns = 0;
+    int highest = 0;
+    double sum = 0.0, sumSquares = 0.0;
+    for (int z = 0; z < depth; ++z) {
+        for (int x = 0; x < size; ++x) {
+            int column = (z % Grid::BRICK) * Grid::BRICK + x % Grid::BRICK;
+            int height = 0;
+            for (int by = 0; by < bricks; ++by) {
+                int b = brickIndex(x / Grid::BRICK, by, z / Grid::BRICK);
+                height = std::max<int>(height, brickTops[(size_t)b * COLUMNS + column]);
+            }
+            if (height == 0) continue;
+            ++columns;
+            highest = std::max(highest, height);
+            sum += height;
+            sumSquares += (double)height * height;
+        }
+    }
+    stats.sandColumns = columns;
+    stats.sandMaxHeight = highest;
+    stats.sandMeanHeight = columns ? sum / columns : 0.0;
+    double variance = columns ? sumSquares / columns - stats.sandMeanHeight * stats.sandMeanHeight : 0.0;
+    stats.sandRoughness = std::sqrt(std::max(variance, 0.0));
+
+    labelClusters(cells, stats);
+}
+
+void Analytics::countBrick(const CellBuffer& cells, int bx, int by, int bz)
+{
+    const int b = brickIndex(bx, by, bz);
+    uint32_t* counts = &brickCounts[(size_t)b * COUNT];
+    uint16_t* tops = &brickTops[(size_t)b * COLUMNS];
+    std::fill(counts, counts + COUNT, 0);
+    std::fill(tops, tops + COLUMNS, 0);
+    uint32_t water = 0;
+
+    const glm::ivec3 lo(bx * Grid::BRICK, by * Grid::BRICK, bz * Grid::BRICK);
+    const glm::ivec3 extent(size, size, depth);
+    for (int z = lo.z; z < lo.z + Grid::BRICK; ++z) {
+        for (int y = lo.y; y < lo.y + Grid::BRICK; ++y) {
+            for (int x = lo.x; x < lo.x + Grid::BRICK; ++x) {
+                Material m = cells[((size_t)z * size + y) * size + x];
+                ++counts[(int)m];
+                if (m == Material::SAND) {
+                    // Rows go up, so the last grain seen in a column is its highest
+                    tops[(z - lo.z) * Grid::BRICK + (x - lo.x)] = (uint16_t)(y + 1);
+                } else if (m == Material::WATER) {
+                    if (x > 0 && x < size - 1 && y > 0 && y < size - 1 && z > 0 && z < depth - 1) {
+                        // Away from the faces, neighbours sit at fixed offsets
+                        const size_t i = ((size_t)z * size + y) * size + x;
+                        const size_t plane = (size_t)size * size;
+                        water += (cells[i - 1] == Material::EMPTY) + (cells[i + 1] == Material::EMPTY)
+                               + (cells[i - size] == Material::EMPTY) + (cells[i + size] == Material::EMPTY)
+                               + (cells[i - plane] == Material::EMPTY) + (cells[i + plane] == Material::EMPTY);
+                        continue;
+                    }
+                    for (int axis = 0; axis < 3; ++axis) {
+                        for (int step = -1; step <= 1; step += 2) {
+                            glm::ivec3 n(x, y, z);
+                            n[axis] += step;
+                            if (n[axis] < 0 || n[axis] >= extent[axis]) {
+                                if (!wrap[axis]) {
+                                    water += waterBeyond[axis];
+                                    continue;
+                                }
+                                n[axis] = (n[axis] + extent[axis]) % extent[axis];
+                            }
+                            water += cells[((size_t)n.z * size + n.y) * size + n.x] == Material::EMPTY;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    brickWater[b] = water;
+}
+
+void Analytics::labelClusters(const CellBuffer& cells, TickStats& stats)
+{
+    stats.clusters = 0;
+    stats.largestCluster = 0;
+    stats.meanCluster = 0.0;
+    if (population[(int)Material::GOL] == 0) return;
+
+    // A brick's links change with its own cells or those of the bricks around it
+    const glm::ivec3 extent(bricks, bricks, layers);
+    std::vector<uint8_t> relink(relabel.size(), 0);
+    for (int bz = 0; bz < layers; ++bz)
+    for (int by = 0; by < bricks; ++by)
+    for (int bx = 0; bx < bricks; ++bx)
+    {
+        if (!relabel[brickIndex(bx, by, bz)]) continue;
+        for (int dz = -1; dz <= 1; ++dz)
+        for (int dy = -1; dy <= 1; ++dy)
+        for (int dx = -1; dx <= 1; ++dx)
+        {
+            glm::ivec3 n(bx + dx, by + dy, bz + dz);
+            bool inside = true;
+            for (int axis = 0; axis < 3; ++axis) {
+                if (n[axis] >= 0 && n[axis] < extent[axis]) continue;
+                inside = inside && wrap[axis];
+                n[axis] = (n[axis] + extent[axis]) % extent[axis];
+            }
+            if (inside) relink[brickIndex(n.x, n.y, n.z)] = 1;
+        }
+    }
+
+    // Bricks only write their own labels and links, so slabs of them refresh in parallel
+    forEachSlab([&](int, int z0, int z1) {
+        for (int bz = z0 / Grid::BRICK; bz < z1 / Grid::BRICK; ++bz)
+        for (int by = 0; by < bricks; ++by)
+        for (int bx = 0; bx < bricks; ++bx)
+        {
+            if (relabel[brickIndex(bx, by, bz)]) labelBrick(cells, bx, by, bz);
+        }
+    });
+    forEachSlab([&](int, int z0, int z1) {
+        for (int bz = z0 / Grid::BRICK; bz < z1 / Grid::BRICK; ++bz)
+        for (int by = 0; by < bricks; ++by)
+        for (int bx = 0; bx < bricks; ++bx)
+        {
+            if (relink[brickIndex(bx, by, bz)]) linkBrick(bx, by, bz);
+        }
+    });
+    std::fill(relabel.begin(), relabel.end(), 0);
+
+    // Every brick's clusters start apart, then join along the links
+    std::vector<int32_t> first(clusterSizes.size());
+    int32_t total = 0;
+    for (size_t b = 0; b < clusterSizes.size(); ++b) {
+        first[b] = total;
+        total += (int32_t)clusterSizes[b].size();
+    }
+    parent.resize(total);
+    for (size_t b = 0; b < clusterSizes.size(); ++b) {
+        for (size_t k = 0; k < clusterSizes[b].size(); ++k) {
+            parent[first[b] + k] = -(int32_t)clusterSizes[b][k];
+        }
+    }
+    for (size_t b = 0; b < clusterLinks.size(); ++b) {
+        for (const ClusterLink& link : clusterLinks[b]) {
+            unite(parent.data(), first[b] + link.cluster, first[link.otherBrick] + link.otherCluster);
+        }
+    }
+
+    // Every root holds its cluster's negated size
+    int64_t members = 0;
+    for (int32_t p : parent) {
+        if (p >= 0) continue;
+        ++stats.clusters;
+        stats.largestCluster = std::max(stats.largestCluster, (int)-p);
+        members += -p;
+    }
+    stats.meanCluster = stats.clusters ? (double)members / stats.clusters : 0.0;
+}
+
+void Analytics::labelBrick(const CellBuffer& cells, int bx, int by, int bz)
+{
+    const int b = brickIndex(bx, by, bz);
+    std::vector<uint16_t>& sizes = clusterSizes[b];
+    uint8_t* live = &liveRows[(size_t)b * ROWS];
+    sizes.clear();
+    std::fill(live, live + ROWS, 0);
+    if (brickCounts[(size_t)b * COUNT + (int)Material::GOL] == 0) return;
+
+    // Runs of live cells along x are joined already, so clusters form from the runs of each row,
+    // each taking the bits of its cells
+    constexpr int MAX_RUNS = ROWS * Grid::BRICK / 2;
+    uint8_t runCells[MAX_RUNS];
+    int32_t runParent[MAX_RUNS];
+    int rowRuns[ROWS + 1];
+    int runs = 0;
+    const glm::ivec3 lo(bx * Grid::BRICK, by * Grid::BRICK, bz * Grid::BRICK);
+    for (int row = 0; row < ROWS; ++row) {
+        const size_t start = ((size_t)(lo.z + row / Grid::BRICK) * size + lo.y + row % Grid::BRICK) * size + lo.x;
+        unsigned mask = liveRow(cells, start);
+        live[row] = (uint8_t)mask;
+
+        // Filling the bits below the lowest run and adding one clears the run, so what that leaves of the mask
+        // is the run
+        rowRuns[row] = runs;
+        while (mask) {
+            const unsigned run = mask & ~((mask | (mask - 1)) + 1);
+            runCells[runs] = (uint8_t)run;
+            runParent[runs++] = -(int32_t)std::bitset<Grid::BRICK>(run).count();
+            mask ^= run;
+        }
+    }
+    rowRuns[ROWS] = runs;
+
+    // Each run joins the runs it touches in the rows before it, the one below it and the three behind it
+    for (int row = 0; row < ROWS; ++row) {
+        const int y = row % Grid::BRICK, z = row / Grid::BRICK;
+        const unsigned reach = live[row] | live[row] << 1 | live[row] >> 1;
+        for (const int* d : AFTER) {
+            if (d[0] != 0 || y - d[1] < 0 || y - d[1] >= Grid::BRICK || z - d[2] < 0) continue;
+            const int before = (z - d[2]) * Grid::BRICK + y - d[1];
+            if (!(live[before] & reach)) continue;
+            for (int r = rowRuns[row]; r < rowRuns[row + 1]; ++r) {
+                const unsigned runReach = runCells[r] | runCells[r] << 1 | runCells[r] >> 1;
+                for (int q = rowRuns[before]; q < rowRuns[before + 1]; ++q) {
+                    if (runCells[q] & runReach) unite(runParent, r, q);
+                }
+            }
+        }
+    }
+
+    // Roots number the clusters in the order met, then each live cell takes its run's number
+    uint8_t number[MAX_RUNS];
+    for (int r = 0; r < runs; ++r) {
+        if (runParent[r] >= 0) continue;
+        number[r] = (uint8_t)sizes.size();
+        sizes.push_back((uint16_t)-runParent[r]);
+    }
+    for (int row = 0; row < ROWS; ++row) {
+        uint8_t* labelRow = &labels[((size_t)b * ROWS + row) * Grid::BRICK];
+        for (int r = rowRuns[row]; r < rowRuns[row + 1]; ++r) {
+            const uint8_t n = number[find(runParent, r)];
+            for (int x = 0; x < Grid::BRICK; ++x) {
+                labelRow[x] = (runCells[r] >> x & 1) ? n : labelRow[x];
+            }
+        }
+    }
+}
+
+void Analytics::linkBrick(int bx, int by, int bz)
+{
+    const int b = brickIndex(bx, by, bz);
+    std::vector<ClusterLink>& links = clusterLinks[b];
+    links.clear();
+    if (clusterSizes[b].empty()) return;
+
+    // Bricks a step along each axis, -1 past a face that does not wrap
+    const glm::ivec3 extent(bricks, bricks, layers);
+    int around[3][3][3];
+    for (int sz = -1; sz <= 1; ++sz)
+    for (int sy = -1; sy <= 1; ++sy)
+    for (int sx = -1; sx <= 1; ++sx)
+    {
+        glm::ivec3 n(bx + sx, by + sy, bz + sz);
+        bool inside = true;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (n[axis] >= 0 && n[axis] < extent[axis]) continue;
+            inside = inside && wrap[axis];
+            n[axis] = (n[axis] + extent[axis]) % extent[axis];
+        }
+        around[sz + 1][sy + 1][sx + 1] = inside ? brickIndex(n.x, n.y, n.z) : -1;
+    }
+
+    // Each row pairs with the rows of the neighbours after its cells, AFTER grouped by row: the row itself
+    // one step along x, and the next row and the three behind it up to a step either way
+    const int rowSteps[5][2] = {{0, 0}, {1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+    const uint8_t* live = &liveRows[(size_t)b * ROWS];
+    const uint8_t ends = 1 | 1 << (Grid::BRICK - 1);
+    for (int row = 0; row < ROWS; ++row) {
+        if (!live[row]) continue;
+        const int y = row % Grid::BRICK, z = row / Grid::BRICK;
+        const uint8_t* rowLabels = &labels[((size_t)b * ROWS + row) * Grid::BRICK];
+        for (int s = 0; s < 5; ++s) {
+            const int ny = y + rowSteps[s][0], nz = z + rowSteps[s][1];
+            const int stepY = (ny >= Grid::BRICK) - (ny < 0);
+            const int stepZ = nz >= Grid::BRICK;
+
+            // Rows within the brick only reach other bricks from their ends
+            if (stepY == 0 && stepZ == 0 && !(live[row] & ends)) continue;
+            const int otherY = ny - stepY * Grid::BRICK, otherZ = nz - stepZ * Grid::BRICK;
+            const int otherRow = otherZ * Grid::BRICK + otherY;
+
+            // A neighbour dx along lies in the brick stepX along, where its bits shift by dx - BRICK * stepX
+            for (int dx = s == 0 ? 1 : -1; dx <= 1; ++dx) {
+                for (int stepX = dx < 0 ? -1 : 0; stepX <= (dx > 0 ? 1 : 0); ++stepX) {
+                    const int other = around[stepZ + 1][stepY + 1][stepX + 1];
+                    if ((stepX == 0 && stepY == 0 && stepZ == 0) || other < 0) continue;
+                    const unsigned otherLive = liveRows[(size_t)other * ROWS + otherRow];
+                    const int shift = Grid::BRICK * stepX - dx;
+                    unsigned pairs = live[row] & (shift >= 0 ? otherLive << shift : otherLive >> -shift) & 0xFF;
+                    if (!pairs) continue;
+
+                    const uint8_t* otherLabels = &labels[((size_t)other * ROWS + otherRow) * Grid::BRICK];
+                    for (int x = 0; pairs; ++x, pairs >>= 1) {
+                        if (!(pairs & 1)) continue;
+                        ClusterLink link{rowLabels[x], otherLabels[x - shift], other};
+                        if (links.empty() || key(links.back()) != key(link)) links.push_back(link);
+                    }
+                }
+            }
+        }
+    }
+
+    // Neighbouring clusters usually touch at many cells, and the merge only needs each pair once
+    std::sort(links.begin(), links.end(), [](const ClusterLink& a, const ClusterLink& c) { return key(a) < key(c); });
+    links.erase(std::unique(links.begin(), links.end(),
+                            [](const ClusterLink& a, const ClusterLink& c) { return key(a) == key(c); }),
+                links.end());
+}
+
+int32_t Analytics::find(int32_t* parent, int32_t i)
+{
+    while (parent[i] >= 0) {
+        int32_t up = parent[i];
+        if (parent[up] >= 0) parent[i] = parent[up];
+        i = up;
+    }
+    return i;
+}
+
+void Analytics::unite(int32_t* parent, int32_t a, int32_t b)
+{
+    a = find(parent, a);
+    b = find(parent, b);
+    if (a == b) return;
+    if (parent[a] > parent[b]) std::swap(a, b);
+    parent[a] += parent[b];
+    parent[b] = a;
+}
+
+template <typename Work>
+void Analytics::forEachSlab(Work work) const
+{
+    // Brick layers split as evenly as possible between the workers, as scenes are filled
+    int slabs = std::min(threads, layers);
+    if (!pool) {
+        work(0, 0, depth);
+        return;
+    }
+    for (int t = 0; t < slabs; ++t) {
+        int z0 = layers * t / slabs * Grid::BRICK;
+        int z1 = layers * (t + 1) / slabs * Grid::BRICK;
+        pool->submit([&work, t, z0, z1] { work(t, z0, z1); });
+    }
+    pool->wait();
+}
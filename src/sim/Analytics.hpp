@@ -0,0 +1,115 @@
+#pragma once
+
+#include "Grid.hpp"
+#include "../utils/ThreadPool.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/// \brief Statistics of the grid after one tick
+struct TickStats
+{
+    uint64_t tick;
+    std::array<size_t, (size_t)Material::COUNT> population;    // Cells of each material
+    int clusters;               // Groups of live cells touching on a face, edge or corner
+    int largestCluster;         // Cells in the biggest group, 0 if none
+    double meanCluster;         // Mean cells per group, 0 if none
+    int sandColumns;            // (x, z) columns holding sand
+    double sandMeanHeight;      // Mean height of the highest grain over those columns
+    int sandMaxHeight;
+    double sandRoughness;       // Standard deviation of those heights
+    size_t waterSurface;        // Faces between water and empty cells
+};
+
+class Analytics
+{
+public:
+    /// \brief Per-tick measurements of a grid, refreshing per-brick counters and clusters only where bricks changed
+    /// \param grid Grid the cells come from, for its size and boundaries
+    /// \param threads Threads to label clusters with, zero for one per core
+    Analytics(const Grid& grid, int threads = 0);
+
+    /// \brief Refresh the counters of bricks changed since the last call
+    /// \param cells Current cells of the grid, or a copy of them
+    /// \param brickRevisions The grid's brick revisions as of those cells
+    /// \param revision The grid's revision as of those cells
+    void update(const CellBuffer& cells, const std::vector<uint64_t>& brickRevisions, uint64_t revision);
+
+    /// \brief Measure the cells last given to update
+    /// \param cells The same cells
+    /// \param stats Filled with everything but the tick
+    void measure(const CellBuffer& cells, TickStats& stats);
+
+    /// \brief Get the number of cells of a material, as of the last update
+    size_t getPopulation(Material m) const { return population[(int)m]; }
+
+private:
+    int size;
+    int depth;
+    int bricks;                     // Bricks along x and y
+    int layers;                     // Bricks along z
+    bool wrap[3];                   // Axes whose faces connect clusters and water
+    bool waterBeyond[3];            // Axes with empty space past their faces, so water there is exposed
+    int threads;
+    std::unique_ptr<ThreadPool> pool;       // Workers the slabs run on, null for one thread
+    uint64_t seenRevision;
+
+    // Per-brick counters, indexed by brick
+    std::vector<uint32_t> brickCounts;      // Cells of each material, Material::COUNT per brick
+    std::vector<uint16_t> brickTops;        // Per column of the brick, one past its highest grain, 0 for none
+    std::vector<uint32_t> brickWater;       // Exposed water faces of the brick's cells
+    std::array<size_t, (size_t)Material::COUNT> population;
+    size_t waterSurface;
+
+    // A pair of live cells touching across a brick's face, edge or corner, by their clusters within each brick
+    struct ClusterLink
+    {
+        uint8_t cluster;            // Cluster of the brick's own cell
+        uint8_t otherCluster;       // Cluster of the other cell within its brick
+        int32_t otherBrick;
+    };
+
+    // Orders links by brick then clusters, equal for links joining the same pair
+    static uint64_t key(const ClusterLink& link)
+    {
+        return (uint64_t)link.otherBrick << 16 | (uint32_t)link.cluster << 8 | link.otherCluster;
+    }
+
+    // Clusters of live cells within each brick, labelled again only when the brick changes
+    // A brick holds at most 64 clusters, as cells two apart on every axis are the most that touch no other
+    std::vector<uint8_t> labels;                        // Cluster of each live cell within its brick, by brick
+    std::vector<uint8_t> liveRows;                      // Live cells of each row along x, a bit each, per brick
+    std::vector<std::vector<uint16_t>> clusterSizes;    // Cells of each cluster, per brick
+    std::vector<std::vector<ClusterLink>> clusterLinks; // Links from the brick's cells to the neighbours after them
+                                                        // in other bricks, per brick
+    std::vector<uint8_t> relabel;                       // Bricks changed since clusters were last labelled
+
+    // Union-find parents of every brick's clusters, a negated cluster size at each root
+    std::vector<int32_t> parent;
+
+    int brickIndex(int bx, int by, int bz) const { return (bz * bricks + by) * bricks + bx; }
+
+    // Recount one brick's materials, sand tops and exposed water
+    void countBrick(const CellBuffer& cells, int bx, int by, int bz);
+
+    // Join the clusters of changed bricks with those of their neighbours and summarize them
+    void labelClusters(const CellBuffer& cells, TickStats& stats);
+
+    // Label a brick's live cells into clusters joined within the brick
+    void labelBrick(const CellBuffer& cells, int bx, int by, int bz);
+
+    // Link a brick's clusters with those of the live neighbours after its cells in other bricks
+    void linkBrick(int bx, int by, int bz);
+
+    // Root of a union-find entry, halving the path on the way
+    static int32_t find(int32_t* parent, int32_t i);
+
+    // Join the sets of two union-find entries, the smaller under the larger
+    static void unite(int32_t* parent, int32_t a, int32_t b);
+
+    // Run work(t, z0, z1) over slabs of whole brick layers on the pool's workers, if any
+    template <typename Work>
+    void forEachSlab(Work work) const;
+};
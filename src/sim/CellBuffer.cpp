@@ -0,0 +1,106 @@
+#include "CellBuffer.hpp"
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+
+CellBuffer::CellBuffer(size_t cells, CellStorage storage, uint8_t* memory)
+    : bytes(memory),
+      length(bytesFor(cells, storage)),
+      cells(cells),
+      packed(storage == CellStorage::PACKED),
+      external(memory != nullptr)
+{
+    static_assert((int)Material::EMPTY == 0, "zeroed storage is empty cells");
+    if (external) {
+        std::memset(bytes, 0, length);
+    } else {
+        owned.assign(length, 0);
+        bytes = owned.data();
+    }
+}
+
+CellBuffer::CellBuffer(const CellBuffer& other)
+    : owned(other.bytes, other.bytes + other.length),
+      bytes(owned.data()),
+      length(other.length),
+      cells(other.cells),
+      packed(other.packed),
+      external(false) {}
+
+CellBuffer& CellBuffer::operator=(const CellBuffer& other)
+{
+    if (this == &other) return *this;
+    if (length == other.length && packed == other.packed) {
+        if (length) std::memcpy(bytes, other.bytes, length);
+    } else {
+        owned.assign(other.bytes, other.bytes + other.length);
+        bytes = owned.data();
+        length = other.length;
+        external = false;
+    }
+    cells = other.cells;
+    packed = other.packed;
+    return *this;
+}
+
+void CellBuffer::fill(size_t begin, size_t end, Material m)
+{
+    if (!packed) {
+        std::fill(bytes + begin, bytes + end, (uint8_t)m);
+        return;
+    }
+
+    // Odd ends take a nibble each, the whole bytes between take two cells at once
+    if (begin < end && (begin & 1)) set(begin++, m);
+    if (begin < end && (end & 1)) set(--end, m);
+    std::fill(bytes + (begin >> 1), bytes + (end >> 1), (uint8_t)((int)m * 0x11));
+}
+
+void CellBuffer::unpack(size_t begin, size_t end, uint8_t* out) const
+{
+    if (!packed) {
+        std::copy(bytes + begin, bytes + end, out);
+        return;
+    }
+
+    // An odd start takes a nibble, then whole bytes give two cells each
+    if (begin < end && (begin & 1)) *out++ = (uint8_t)(*this)[begin++];
+    for (; begin + 1 < end; begin += 2) {
+        const uint8_t b = bytes[begin >> 1];
+        *out++ = b & 0xF;
+        *out++ = b >> 4;
+    }
+    if (begin < end) *out = (uint8_t)(*this)[begin];
+}
+
+void CellBuffer::pack(size_t begin, size_t end, const uint8_t* in)
+{
+    if (!packed) {
+        std::copy(in, in + (end - begin), bytes + begin);
+        return;
+    }
+
+    if (begin < end && (begin & 1)) set(begin++, (Material)*in++);
+    for (; begin + 1 < end; begin += 2, in += 2) {
+        bytes[begin >> 1] = (uint8_t)(in[0] | in[1] << 4);
+    }
+    if (begin < end) set(begin, (Material)*in);
+}
+
+size_t CellBuffer::count(Material m) const
+{
+    if (!packed) return (size_t)std::count(bytes, bytes + length, (uint8_t)m);
+
+    // Count matching nibbles a word at a time, then the tail a cell at a time
+    size_t total = 0;
+    size_t words = cells / 16;
+    for (size_t w = 0; w < words; ++w) {
+        uint64_t word;
+        std::memcpy(&word, &bytes[w * 8], sizeof(word));
+        total += std::bitset<64>(Packed::match(word, m)).count();
+    }
+    for (size_t i = words * 16; i < cells; ++i) {
+        total += (*this)[i] == m;
+    }
+    return total;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Materials.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// \brief How a cell buffer stores its cells
+enum class CellStorage : uint8_t
+{
+    BYTE,       // One cell per byte
+    PACKED      // Two cells per byte, the even cell in the low nibble
+};
+
+static_assert((int)Material::COUNT <= 16, "packed cells hold a material in a nibble");
+
+class CellBuffer
+{
+public:
+    /// \brief Materials of a run of cells, a byte each or two to a byte
+    /// \param cells Number of cells, all empty
+    /// \param storage Byte or packed storage
+    /// \param memory Caller-owned storage of bytesFor(cells, storage) bytes to use instead of allocating,
+    /// which must outlive the buffer and is cleared
+    explicit CellBuffer(size_t cells = 0, CellStorage storage = CellStorage::BYTE, uint8_t* memory = nullptr);
+
+    /// \brief Copy the cells into storage of their own
+    CellBuffer(const CellBuffer& other);
+
+    /// \brief Copy the cells, in place when the layouts match so caller-owned storage stays in use
+    CellBuffer& operator=(const CellBuffer& other);
+
+    CellBuffer(CellBuffer&& other) = default;
+    CellBuffer& operator=(CellBuffer&& other) = default;
+
+    /// \brief Get the raw storage size a number of cells takes
+    static size_t bytesFor(size_t cells, CellStorage storage)
+    {
+        return storage == CellStorage::PACKED ? (cells + 1) / 2 : cells;
+    }
+
+    /// \brief Check if the storage belongs to the caller rather than the buffer
+    bool isExternal() const { return external; }
+
+    /// \brief Get the number of cells
+    size_t size() const { return cells; }
+
+    /// \brief Check if the cells are packed two to a byte
+    bool isPacked() const { return packed; }
+
+    /// \brief Get the material of a cell
+    Material operator[](size_t i) const
+    {
+        if (!packed) return (Material)bytes[i];
+        return (Material)((bytes[i >> 1] >> ((i & 1) << 2)) & 0xF);
+    }
+
+    /// \brief Set the material of a cell
+    void set(size_t i, Material m)
+    {
+        if (!packed) {
+            bytes[i] = (uint8_t)m;
+            return;
+        }
+        int shift = (int)(i & 1) << 2;
+        uint8_t& b = bytes[i >> 1];
+        b = (uint8_t)((b & ~(0xF << shift)) | ((int)m << shift));
+    }
+
+    /// \brief Set the cells [begin, end) to one material
+    void fill(size_t begin, size_t end, Material m);
+
+    /// \brief Copy the cells [begin, end) out, a byte each
+    void unpack(size_t begin, size_t end, uint8_t* out) const;
+
+    /// \brief Set the cells [begin, end) from a byte each
+    void pack(size_t begin, size_t end, const uint8_t* in);
+
+    /// \brief Count the cells holding a material
+    size_t count(Material m) const;
+
+    /// \brief Get the raw storage, for copying cells in bulk between buffers of the same storage
+    uint8_t* data() { return bytes; }
+
+    /// \brief Get the raw storage
+    const uint8_t* data() const { return bytes; }
+
+    /// \brief Get the size of the raw storage in bytes
+    size_t byteSize() const { return length; }
+
+    /// \brief Get the raw storage offset of a cell, which must be even when packed
+    size_t byteOffset(size_t i) const { return packed ? i >> 1 : i; }
+
+    /// \brief Get the raw storage size of a run of cells, which must be even when packed
+    size_t byteCount(size_t n) const { return packed ? n >> 1 : n; }
+
+private:
+    std::vector<uint8_t> owned;     // Storage unless the caller provided it
+    uint8_t* bytes;                 // Start of the storage in use
+    size_t length;                  // Bytes of storage
+    size_t cells;
+    bool packed;
+    bool external;
+};
+
+/// \brief SWAR helpers for packed cells, sixteen to a 64-bit word loaded little-endian, cell 0 lowest
+namespace Packed {
+    constexpr uint64_t LOW_BITS = 0x1111111111111111ull;     // Lowest bit of every nibble
+    constexpr uint64_t HIGH_BITS = 0x8888888888888888ull;    // Highest bit of every nibble
+    constexpr uint64_t EVEN_NIBBLES = 0x0F0F0F0F0F0F0F0Full; // Even cells, one per byte lane
+
+    /// \brief Get a word with the lowest bit of each nibble set where the nibble holds a material
+    inline uint64_t match(uint64_t word, Material m)
+    {
+        // A nibble is zero after the xor exactly when adding 7 to its low bits leaves its high bit clear
+        uint64_t x = word ^ (LOW_BITS * (uint64_t)m);
+        uint64_t zero = ~(((x & ~HIGH_BITS) + (~HIGH_BITS & (LOW_BITS * 7))) | x) & HIGH_BITS;
+        return zero >> 3;
+    }
+
+    /// \brief Get the material in one nibble of a word
+    inline Material lane(uint64_t word, int i)
+    {
+        return (Material)((word >> (i << 2)) & 0xF);
+    }
+}
@@ -0,0 +1,42 @@
+#include "CellFields.hpp"
+#include <algorithm>
+
+CellFields::CellFields(size_t cells) : cells(cells), allocated(0) {}
+
+void CellFields::enable(CellField f)
+{
+    switch (f) {
+        case CellField::TEMPERATURE:
+            buffers<CellField::TEMPERATURE>();
+            break;
+        case CellField::VELOCITY_X:
+            buffers<CellField::VELOCITY_X>();
+            break;
+        case CellField::VELOCITY_Y:
+            buffers<CellField::VELOCITY_Y>();
+            break;
+        case CellField::VELOCITY_Z:
+            buffers<CellField::VELOCITY_Z>();
+            break;
+        case CellField::AGE:
+            buffers<CellField::AGE>();
+            break;
+        case CellField::COUNT:
+        default:
+            break;
+    }
+}
+
+void CellFields::swap()
+{
+    // Unallocated fields are empty, so swapping them costs nothing
+    std::apply([](auto&... pair) { (std::swap(pair[0], pair[1]), ...); }, fields);
+}
+
+void CellFields::clear()
+{
+    std::apply([](auto&... pair) {
+        (std::fill(pair[0].begin(), pair[0].end(), 0), ...);
+        (std::fill(pair[1].begin(), pair[1].end(), 0), ...);
+    }, fields);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// \brief Optional per-cell quantities kept beside the material, each in its own array
+enum class CellField : uint8_t
+{
+    TEMPERATURE,    // Heat, conducted between neighbouring cells
+    VELOCITY_X,     // Cells the sand in a cell moved along x this tick
+    VELOCITY_Y,
+    VELOCITY_Z,
+    AGE,            // Ticks since the cell's material last changed, saturating
+    COUNT
+};
+
+/// \brief Element type of each field, in CellField order
+using CellFieldTypes = std::tuple<float, int8_t, int8_t, int8_t, uint16_t>;
+
+static_assert(std::tuple_size<CellFieldTypes>::value == (size_t)CellField::COUNT, "one type per field");
+
+/// \brief Element type of one field
+template <CellField F>
+using CellFieldType = std::tuple_element_t<(size_t)F, CellFieldTypes>;
+
+class CellFields
+{
+public:
+    /// \brief Double-buffered per-cell fields, none allocated until first used
+    /// \param cells Number of cells in each field
+    explicit CellFields(size_t cells = 0);
+
+    /// \brief Check if a field has been allocated
+    bool has(CellField f) const { return allocated >> (int)f & 1; }
+
+    /// \brief Check if any field has been allocated
+    bool any() const { return allocated != 0; }
+
+    /// \brief Allocate a field's buffers, zeroed, if it has none yet
+    void enable(CellField f);
+
+    /// \brief Get a field's current values, allocating it on first use
+    template <CellField F>
+    std::vector<CellFieldType<F>>& current() { return buffers<F>()[0]; }
+
+    /// \brief Get a field's current values, empty if it was never used
+    template <CellField F>
+    const std::vector<CellFieldType<F>>& current() const { return std::get<(size_t)F>(fields)[0]; }
+
+    /// \brief Get a field's next values, allocating it on first use
+    template <CellField F>
+    std::vector<CellFieldType<F>>& next() { return buffers<F>()[1]; }
+
+    /// \brief Call fn(field, values) with the current values of every allocated field, in CellField order.
+    /// The field comes as a std::integral_constant, so fn can also name it at compile time
+    template <typename Fn>
+    void forEach(Fn&& fn) { forEach(*this, fn, std::make_index_sequence<(size_t)CellField::COUNT>()); }
+
+    /// \brief Call fn(field, values) with the current values of every allocated field, in CellField order
+    template <typename Fn>
+    void forEach(Fn&& fn) const { forEach(*this, fn, std::make_index_sequence<(size_t)CellField::COUNT>()); }
+
+    /// \brief Make every allocated field's next values current
+    void swap();
+
+    /// \brief Zero every allocated field
+    void clear();
+
+private:
+    template <typename T>
+    using Buffers = std::array<std::vector<T>, 2>;
+
+    // Current and next values of each field, in CellField order
+    template <typename... T>
+    static std::tuple<Buffers<T>...> buffersOf(std::tuple<T...>);
+
+    decltype(buffersOf(CellFieldTypes())) fields;
+    size_t cells;
+    uint32_t allocated;             // Bit per allocated field
+
+    template <typename Self, typename Fn, size_t... I>
+    static void forEach(Self& self, Fn& fn, std::index_sequence<I...>)
+    {
+        ((self.has((CellField)I) ? fn(std::integral_constant<CellField, (CellField)I>(), std::get<I>(self.fields)[0])
+                                 : void()), ...);
+    }
+
+    // A field's buffers, allocated on first use
+    template <CellField F>
+    Buffers<CellFieldType<F>>& buffers()
+    {
+        auto& pair = std::get<(size_t)F>(fields);
+        if (!has(F)) {
+            pair[0].assign(cells, 0);
+            pair[1].assign(cells, 0);
+            allocated |= 1u << (int)F;
+        }
+        return pair;
+    }
+};
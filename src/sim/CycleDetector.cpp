@@ -0,0 +1,186 @@
+#include "CycleDetector.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    // 64-bit finalizer from MurmurHash3
+    uint64_t mix(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return h;
+    }
+}
+
+CycleDetector::CycleDetector() : gridHash(0), tick(0), seenRevision(0),
+                                 period(0), cycleStart(-1), locked(false), phase(0) {}
+
+bool CycleDetector::replay(Grid& grid)
+{
+    if (grid.getRevision() != seenRevision) {
+        reset();
+        return false;
+    }
+    if (!locked) return false;
+
+    // Dirty flags still mean "changed this tick", so renderers see exactly the replayed bricks
+    grid.clearDirty();
+    const Frame& frame = frames[phase];
+    auto& cells = grid.getCurrentBuffer();
+    auto& mass = grid.getMassBuffer();
+    const int bricks = grid.getBricks();
+    const size_t rowBytes = cells.byteCount(Grid::BRICK);
+    size_t offset = 0;
+    size_t cellOffset = 0;
+    for (int b : frame.bricks) {
+        int bx = b % bricks * Grid::BRICK;
+        int by = b / bricks % bricks * Grid::BRICK;
+        int bz = b / (bricks * bricks) * Grid::BRICK;
+        for (int z = bz; z < bz + Grid::BRICK; ++z) {
+            for (int y = by; y < by + Grid::BRICK; ++y) {
+                int row = grid.index(bx, y, z);
+                std::copy_n(frame.cells.begin() + cellOffset, rowBytes, cells.data() + cells.byteOffset(row));
+                std::copy_n(frame.mass.begin() + offset, Grid::BRICK, mass.begin() + row);
+                cellOffset += rowBytes;
+                offset += Grid::BRICK;
+            }
+        }
+        grid.markDirty(bx, by, bz);
+    }
+
+    gridHash = history[(history.size() - period + phase) % history.size()];
+    phase = (phase + 1) % period;
+    seenRevision = grid.getRevision();
+    ++tick;
+    return true;
+}
+
+void CycleDetector::observe(const Grid& grid, bool deterministic)
+{
+    ++tick;
+
+    // Rehash only the bricks the tick touched, and keep the ones that really changed
+    const int bricks = grid.getBricks();
+    const size_t count = (size_t)bricks * bricks * bricks;
+    std::vector<int> changed;
+    if (brickHash.size() != count) {
+        brickHash.assign(count, 0);
+        gridHash = 0;
+        for (int bz = 0; bz < bricks; ++bz)
+        for (int by = 0; by < bricks; ++by)
+        for (int bx = 0; bx < bricks; ++bx)
+        {
+            int i = grid.brickIndex(bx, by, bz);
+            brickHash[i] = hashBrick(grid, bx, by, bz);
+            gridHash += place(brickHash[i], i);
+        }
+    } else {
+        const auto& dirty = grid.getDirtyBricks();
+        for (int i = 0; i < (int)count; ++i) {
+            if (!dirty[i]) continue;
+            uint64_t h = hashBrick(grid, i % bricks, i / bricks % bricks, i / (bricks * bricks));
+            if (h == brickHash[i]) continue;
+            gridHash += place(h, i) - place(brickHash[i], i);
+            brickHash[i] = h;
+            changed.push_back(i);
+        }
+    }
+    seenRevision = grid.getRevision();
+
+    if (period > 0) {
+        // Confirm a candidate over one whole repeat, recording each tick's changes to replay
+        if (!deterministic || history[history.size() - period] != gridHash) {
+            period = 0;
+            frames.clear();
+        } else {
+            frames.push_back(capture(grid, changed));
+            if ((int)frames.size() == period) {
+                locked = true;
+                phase = 0;
+            }
+        }
+    }
+
+    if (period == 0) {
+        // A repeat of any state in the window is a candidate cycle of that length
+        for (int k = 1; k <= (int)history.size(); ++k) {
+            if (history[history.size() - k] == gridHash) {
+                period = k;
+                cycleStart = tick - k;
+                break;
+            }
+        }
+    }
+
+    history.push_back(gridHash);
+    if ((int)history.size() > MAX_PERIOD) history.pop_front();
+}
+
+void CycleDetector::reset()
+{
+    brickHash.clear();
+    gridHash = 0;
+    history.clear();
+    period = 0;
+    cycleStart = -1;
+    locked = false;
+    frames.clear();
+    phase = 0;
+}
+
+uint64_t CycleDetector::hashBrick(const Grid& grid, int bx, int by, int bz)
+{
+    static_assert(Grid::BRICK == 8, "rows are hashed as one 64-bit word");
+    const auto& cells = grid.getCurrentBuffer();
+    const auto& mass = grid.getMassBuffer();
+
+    // Packed rows are half a word, and the other half stays zero
+    const size_t rowBytes = cells.byteCount(Grid::BRICK);
+    uint64_t h = 0;
+    for (int z = bz * Grid::BRICK; z < (bz + 1) * Grid::BRICK; ++z) {
+        for (int y = by * Grid::BRICK; y < (by + 1) * Grid::BRICK; ++y) {
+            int row = grid.index(bx * Grid::BRICK, y, z);
+            uint64_t c = 0, m;
+            std::memcpy(&c, cells.data() + cells.byteOffset(row), rowBytes);
+            std::memcpy(&m, &mass[row], sizeof(m));
+            h = mix(h ^ c);
+            h = mix(h ^ m);
+        }
+    }
+    return h;
+}
+
+CycleDetector::Frame CycleDetector::capture(const Grid& grid, const std::vector<int>& changed)
+{
+    const int bricks = grid.getBricks();
+    const auto& cells = grid.getCurrentBuffer();
+    const auto& mass = grid.getMassBuffer();
+
+    Frame frame;
+    frame.bricks = changed;
+    const size_t rowBytes = cells.byteCount(Grid::BRICK);
+    frame.cells.reserve(changed.size() * Grid::BRICK * Grid::BRICK * rowBytes);
+    frame.mass.reserve(changed.size() * Grid::BRICK * Grid::BRICK * Grid::BRICK);
+    for (int b : changed) {
+        int bx = b % bricks * Grid::BRICK;
+        int by = b / bricks % bricks * Grid::BRICK;
+        int bz = b / (bricks * bricks) * Grid::BRICK;
+        for (int z = bz; z < bz + Grid::BRICK; ++z) {
+            for (int y = by; y < by + Grid::BRICK; ++y) {
+                int row = grid.index(bx, y, z);
+                const uint8_t* src = cells.data() + cells.byteOffset(row);
+                frame.cells.insert(frame.cells.end(), src, src + rowBytes);
+                frame.mass.insert(frame.mass.end(), mass.begin() + row, mass.begin() + row + Grid::BRICK);
+            }
+        }
+    }
+    return frame;
+}
+
+uint64_t CycleDetector::place(uint64_t hash, int brick)
+{
+    return mix(hash + (uint64_t)brick * 0x9e3779b97f4a7c15ull);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Grid.hpp"
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+class CycleDetector
+{
+public:
+    static constexpr int MAX_PERIOD = 16;   // Longest cycle looked for, in ticks
+
+    /// \brief Spots a grid repeating an earlier state and replays the cycle instead of recomputing it
+    CycleDetector();
+
+    /// \brief Advance a locked cycle by one tick
+    /// \param grid Grid the cycle was detected on
+    /// \return False if no cycle is locked, or the grid was edited since the last tick
+    bool replay(Grid& grid);
+
+    /// \brief Record the state left by a computed tick
+    /// \param grid Grid after the tick, with its dirty flags marking the bricks the tick changed
+    /// \param deterministic False if the tick made random choices that could have gone another way
+    void observe(const Grid& grid, bool deterministic);
+
+    /// \brief Forget all history, after the grid was replaced or edited
+    void reset();
+
+    /// \brief Get the locked cycle length, 1 for a fixed point and 0 while still searching
+    int getPeriod() const { return locked ? period : 0; }
+
+    /// \brief Get the tick at which the repeating state first appeared, -1 while still searching
+    int64_t getCycleStart() const { return locked ? cycleStart : -1; }
+
+    /// \brief Get the whole-grid state hash
+    uint64_t getHash() const { return gridHash; }
+
+private:
+    /// Cells of the bricks one tick of the cycle changes, as they are after it
+    struct Frame
+    {
+        std::vector<int> bricks;
+        std::vector<uint8_t> cells;     // Raw rows, in the grid's cell storage
+        std::vector<uint8_t> mass;
+    };
+
+    std::vector<uint64_t> brickHash;    // Per-brick state hash, indexed by brickIndex
+    uint64_t gridHash;                  // Order-independent sum over brickHash, updated per changed brick
+    std::deque<uint64_t> history;       // Grid hashes of the last MAX_PERIOD ticks, newest last
+    int64_t tick;                       // Computed ticks observed
+    uint64_t seenRevision;              // Grid revision after the last tick, to spot edits
+
+    int period;                         // Candidate or locked cycle length
+    int64_t cycleStart;
+    bool locked;
+    std::vector<Frame> frames;          // One per tick of the candidate or locked cycle
+    int phase;                          // Next frame to replay
+
+    // Hash of one brick's materials and water mass
+    static uint64_t hashBrick(const Grid& grid, int bx, int by, int bz);
+
+    // Contribution of a brick hash to the grid hash, distinct per position
+    static uint64_t place(uint64_t hash, int brick);
+
+    // Copy the current cells of the given bricks
+    static Frame capture(const Grid& grid, const std::vector<int>& changed);
+};
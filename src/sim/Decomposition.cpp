@@ -0,0 +1,84 @@
+#include "Decomposition.hpp"
+#include <iostream>
+
+Decomposition::Decomposition(Transport& transport, int size, Boundary zBoundary)
+    : transport(transport),
+      bricks(Grid::roundSize(size) / Grid::BRICK),
+      neighbours{-1, -1},
+      failed(false)
+{
+    // A single slab wraps its own z, so only a true split links the ends of a periodic axis
+    const int rank = transport.getRank();
+    const int processes = transport.getSize();
+    bool wrap = zBoundary == Boundary::PERIODIC && processes > 1;
+    if (rank > 0 || wrap) neighbours[0] = (rank + processes - 1) % processes;
+    if (rank < processes - 1 || wrap) neighbours[1] = (rank + 1) % processes;
+}
+
+bool Decomposition::gather(const Grid& slab, Grid& full)
+{
+    const int rank = transport.getRank();
+    const int plane = slab.getSize() * slab.getSize();
+
+    // Raw cells, mass, then each allocated field, the same layout each slab's buffers already have
+    const CellBuffer& slabCells = slab.getCurrentBuffer();
+    std::vector<uint8_t> message(slabCells.byteSize() + slab.getMassBuffer().size());
+    std::memcpy(message.data(), slabCells.data(), slabCells.byteSize());
+    std::memcpy(message.data() + slabCells.byteSize(), slab.getMassBuffer().data(), slab.getMassBuffer().size());
+    size_t valueBytes = 0;          // Bytes of every allocated field for one cell
+    slab.getFields().forEach([&](CellField, const auto& values) {
+        const uint8_t* raw = reinterpret_cast<const uint8_t*>(values.data());
+        message.insert(message.end(), raw, raw + values.size() * sizeof(values[0]));
+        valueBytes += sizeof(values[0]);
+    });
+    if (rank != 0) {
+        if (!transport.exchange(0, message.data(), message.size(), -1, received)) failed = true;
+        return !failed;
+    }
+
+    // Every slab was filled alike, so they all allocated the fields this one has
+    auto& cells = full.getCurrentBuffer();
+    auto& mass = full.getMassBuffer();
+    slab.getFields().forEach([&](CellField f, const auto&) { full.getFields().enable(f); });
+    for (int r = 0; r < transport.getSize(); ++r) {
+        if (r != 0 && !transport.exchange(-1, nullptr, 0, r, received)) {
+            failed = true;
+            return false;
+        }
+        const std::vector<uint8_t>& from = (r == 0) ? message : received;
+        size_t count = (size_t)plane * (slabBegin(r + 1) - slabBegin(r));
+        size_t cellBytes = cells.byteCount(count);
+        if (from.size() != cellBytes + count * (1 + valueBytes)) {
+            std::cerr << "Slab of rank " << r << " has the wrong size" << std::endl;
+            failed = true;
+            return false;
+        }
+        size_t offset = (size_t)plane * slabBegin(r);
+        std::memcpy(cells.data() + cells.byteOffset(offset), from.data(), cellBytes);
+        std::memcpy(&mass[offset], from.data() + cellBytes, count);
+
+        size_t read = cellBytes + count;
+        full.getFields().forEach([&](CellField, auto& values) {
+            std::memcpy(&values[offset], from.data() + read, count * sizeof(values[0]));
+            read += count * sizeof(values[0]);
+        });
+    }
+    full.markAllDirty();
+    return true;
+}
+
+int Decomposition::slabBegin(int rank) const
+{
+    return bricks * rank / transport.getSize() * Grid::BRICK;
+}
+
+void Decomposition::shiftBytes(int side, const void* data, size_t bytes)
+{
+    // A failed exchange leaves the run unrecoverable, so later ticks stop talking
+    received.clear();
+    if (failed) return;
+    if (!transport.exchange(neighbours[side], data, bytes, neighbours[1 - side], received)) {
+        std::cerr << "Halo exchange failed on rank " << transport.getRank() << std::endl;
+        failed = true;
+    }
+}
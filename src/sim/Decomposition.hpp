@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Grid.hpp"
+#include "Transport.hpp"
+#include <cstring>
+#include <vector>
+
+class Decomposition
+{
+public:
+    /// \brief Split a grid into brick-aligned slabs of z, one per process
+    /// \param transport Messaging between the processes, one per slab
+    /// \param size Grid edge length in cells, as given to the grid
+    /// \param zBoundary Boundary of the z axis, periodic links the first and last slabs
+    Decomposition(Transport& transport, int size, Boundary zBoundary);
+
+    /// \brief Get this process's rank
+    int getRank() const { return transport.getRank(); }
+
+    /// \brief Get the first z of this process's slab
+    int getBegin() const { return slabBegin(transport.getRank()); }
+
+    /// \brief Get the end of the z range of this process's slab
+    int getEnd() const { return slabBegin(transport.getRank() + 1); }
+
+    /// \brief Get the rank of the slab past one z face
+    /// \param side 0 for the slab below, 1 for the slab above
+    /// \return -1 if the face is a wall or open face of the whole grid
+    int getNeighbour(int side) const { return neighbours[side]; }
+
+    /// \brief Send to the neighbour on one side while receiving from the neighbour on the other
+    /// \param side Side to send to, 0 below or 1 above; the message arrives from the opposite side
+    /// \param out Message to send, dropped when there is no neighbour that way
+    /// \param in Filled with the received message, empty when there is no neighbour that way
+    template <typename T>
+    void shift(int side, const std::vector<T>& out, std::vector<T>& in);
+
+    /// \brief Assemble every slab's cells, water mass and allocated fields into a whole grid on rank 0
+    /// \param slab This process's slab
+    /// \param full Grid of the whole size and the slab's storage, only written on rank 0
+    bool gather(const Grid& slab, Grid& full);
+
+    /// \brief Check that every exchange so far succeeded
+    bool ok() const { return !failed; }
+
+private:
+    Transport& transport;
+    int bricks;                     // Grid edge length in bricks
+    int neighbours[2];              // Ranks below and above, -1 for none
+    std::vector<uint8_t> received;
+    bool failed;
+
+    // First z of a rank's slab, slabs split the bricks as evenly as possible
+    int slabBegin(int rank) const;
+
+    // Exchange raw bytes with the neighbours, noting any failure
+    void shiftBytes(int side, const void* data, size_t bytes);
+};
+
+template <typename T>
+void Decomposition::shift(int side, const std::vector<T>& out, std::vector<T>& in)
+{
+    shiftBytes(side, out.data(), out.size() * sizeof(T));
+    in.resize(received.size() / sizeof(T));
+    if (!in.empty()) std::memcpy(in.data(), received.data(), in.size() * sizeof(T));
+}
@@ -2,60 +2,410 @@
 
 #include "Grid.hpp"
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
 
-Grid::Grid() : current(SIZE * SIZE * SIZE, Material::EMPTY), 
-               next(SIZE * SIZE * SIZE, Material::EMPTY)
+Grid::Grid(int requestedSize, const Boundaries& boundaries, CellStorage storage, int zBegin, int zEnd,
+           uint8_t* cellMemory)
+    : size(roundSize(requestedSize)),
+      bricks(size / BRICK),
+      depth((zEnd < 0 ? size : zEnd) - zBegin),
+      zOrigin(zBegin),
+      boundaries(boundaries),
+      current((size_t)size * size * depth, storage, cellMemory),
+      next((size_t)size * size * depth, storage,
+           cellMemory ? cellMemory + CellBuffer::bytesFor((size_t)size * size * depth, storage) : nullptr),
+      wallRow(size, storage),
+      emptyRow(size, storage),
+      mass(size * size * depth, 0),
+      fields((size_t)size * size * depth),
+      dirty(bricks * bricks * (depth / BRICK), 1),
+      brickRevision(bricks * bricks * (depth / BRICK), 1),
+      revision(1)
 {
-    // Add initial walls (floor and walls)
-    for (int x = 0; x < SIZE; ++x) {
-        for (int z = 0; z < SIZE; ++z) {
-            set(x, 0, z, Material::WALL);
-            set(x, SIZE - 1, z, Material::WALL);
+    wallRow.fill(0, size, Material::WALL);
+
+    // Add initial walls on the faces of wall axes (floor and walls), which a slab may not reach
+    int n = size;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (boundaries[axis] != Boundary::WALL) continue;
+        glm::ivec3 hi(n);
+        hi[axis] = 1;
+        fillBox(glm::ivec3(0), hi, Material::WALL);
+        glm::ivec3 lo(0);
+        lo[axis] = n - 1;
+        fillBox(lo, glm::ivec3(n), Material::WALL);
+    }
+}
+
+Material Grid::get(int x, int y, int z) const
+{
+    if (!inBounds(x, y, z)) {
+        glm::ivec3 c(x, y, z);
+        glm::ivec3 extent(size, size, depth);
+        for (int axis = 2; axis >= 0; --axis) {
+            if (c[axis] >= 0 && c[axis] < extent[axis]) continue;
+            if (boundaries[axis] == Boundary::WALL) return Material::WALL;
+            if (!wraps(axis)) return Material::EMPTY;
+            c[axis] = (c[axis] % extent[axis] + extent[axis]) % extent[axis];
         }
+        return current[index(c.x, c.y, c.z)];
     }
-    for (int y = 0; y < SIZE; ++y) {
-        for (int z = 0; z < SIZE; ++z) {
-            set(0, y, z, Material::WALL);
-            set(SIZE - 1, y, z, Material::WALL);
+    return current[index(x, y, z)];
+}
+
+void Grid::set(int x, int y, int z, Material m)
+{
+    if (!inBounds(x, y, z)) return;
+    int i = index(x, y, z);
+    current.set(i, m);
+    mass[i] = (m == Material::WATER) ? FULL_MASS : 0;
+    markDirty(x, y, z);
+}
+
+void Grid::fillBox(const glm::ivec3& lo, const glm::ivec3& hi, Material m,
+                   const glm::ivec3& clipLo, const glm::ivec3& clipHi)
+{
+    glm::ivec3 a = lo, b = hi;
+    if (!clipBox(a, b, clipLo, clipHi)) return;
+
+    for (int z = a.z; z < b.z; ++z) {
+        for (int y = a.y; y < b.y; ++y) {
+            fillRow(y, z, a.x, b.x, m);
         }
     }
-    for (int x = 0; x < SIZE; ++x) {
-        for (int y = 0; y < SIZE; ++y) {
-            set(x, y, 0, Material::WALL);
-            set(x, y, SIZE - 1, Material::WALL);
+    markRegionDirty(a, b);
+}
+
+void Grid::fillSphere(const glm::vec3& center, float radius, Material m,
+                      const glm::ivec3& clipLo, const glm::ivec3& clipHi)
+{
+    glm::ivec3 a(glm::floor(center - radius));
+    glm::ivec3 b = glm::ivec3(glm::floor(center + radius)) + 1;
+    if (!clipBox(a, b, clipLo, clipHi)) return;
+
+    // Each row of a sphere is one contiguous run of cells
+    float r2 = radius * radius;
+    for (int z = a.z; z < b.z; ++z) {
+        for (int y = a.y; y < b.y; ++y) {
+            float dy = y - center.y;
+            float dz = z - center.z;
+            float rest = r2 - dy * dy - dz * dz;
+            if (rest < 0.0f) continue;
+
+            float half = std::sqrt(rest);
+            int x0 = std::max((int)std::ceil(center.x - half), a.x);
+            int x1 = std::min((int)std::floor(center.x + half) + 1, b.x);
+            if (x0 < x1) fillRow(y, z, x0, x1, m);
         }
     }
+    markRegionDirty(a, b);
 }
 
-Material Grid::get(int x, int y, int z) const
+void Grid::fillLine(const glm::vec3& a, const glm::vec3& b, float radius, Material m,
+                    const glm::ivec3& clipLo, const glm::ivec3& clipHi)
 {
-    if (!inBounds(x, y, z)) return Material::WALL;
-    return current[index(x, y, z)];
+    // Stamp spheres close enough together that the stroke has no gaps
+    float spacing = std::max(radius * 0.5f, 0.5f);
+    int stamps = (int)std::ceil(glm::length(b - a) / spacing);
+    for (int i = 0; i <= stamps; ++i) {
+        float t = stamps ? (float)i / stamps : 0.0f;
+        glm::vec3 c = glm::mix(a, b, t);
+        // Thin strokes snap to cell centres, which a sub-cell sphere would miss
+        if (radius < 0.5f) c = glm::floor(c + 0.5f);
+        fillSphere(c, radius, m, clipLo, clipHi);
+    }
 }
 
-void Grid::set(int x, int y, int z, Material m)
+void Grid::fillNoise(const glm::ivec3& lo, const glm::ivec3& hi, Material m, float probability, uint32_t seed,
+                     const glm::ivec3& clipLo, const glm::ivec3& clipHi)
 {
-    if (!inBounds(x, y, z)) return;
-    current[index(x, y, z)] = m;
+    glm::ivec3 a = lo, b = hi;
+    if (!clipBox(a, b, clipLo, clipHi)) return;
+
+    // Hashing the coordinate keeps the pattern independent of fill order
+    uint32_t threshold = (uint32_t)(std::clamp(probability, 0.0f, 1.0f) * 4294967295.0f);
+    uint8_t cellMass = (m == Material::WATER) ? FULL_MASS : 0;
+    for (int z = a.z; z < b.z; ++z) {
+        for (int y = a.y; y < b.y; ++y) {
+            int row = index(0, y, z - zOrigin);
+            for (int x = a.x; x < b.x; ++x) {
+                uint32_t h = seed ^ ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u);
+                h ^= h >> 16; h *= 0x85ebca6bu;
+                h ^= h >> 13; h *= 0xc2b2ae35u;
+                h ^= h >> 16;
+                if (h < threshold) {
+                    current.set(row + x, m);
+                    mass[row + x] = cellMass;
+                }
+            }
+        }
+    }
+    markRegionDirty(a, b);
+}
+
+void Grid::pasteVolume(const glm::ivec3& origin, const glm::ivec3& dims, const std::vector<Material>& cells,
+                       const glm::ivec3& clipLo, const glm::ivec3& clipHi)
+{
+    glm::ivec3 a = origin, b = origin + dims;
+    if (!clipBox(a, b, clipLo, clipHi)) return;
+
+    for (int z = a.z; z < b.z; ++z) {
+        for (int y = a.y; y < b.y; ++y) {
+            const Material* src = &cells[((z - origin.z) * dims.y + (y - origin.y)) * dims.x + (a.x - origin.x)];
+            int row = index(0, y, z - zOrigin);
+            for (int x = a.x; x < b.x; ++x) {
+                Material m = src[x - a.x];
+                current.set(row + x, m);
+                mass[row + x] = (m == Material::WATER) ? FULL_MASS : 0;
+            }
+        }
+    }
+    markRegionDirty(a, b);
+}
+
+void Grid::fillRow(int y, int z, int x0, int x1, Material m)
+{
+    int row = index(0, y, z - zOrigin);
+    current.fill(row + x0, row + x1, m);
+    std::fill(mass.begin() + row + x0, mass.begin() + row + x1,
+              (m == Material::WATER) ? FULL_MASS : 0);
+}
+
+void Grid::markRegionDirty(const glm::ivec3& lo, const glm::ivec3& hi)
+{
+    uint64_t stamp = ++revision;
+    for (int bz = (lo.z - zOrigin) / BRICK; bz <= (hi.z - 1 - zOrigin) / BRICK; ++bz)
+    for (int by = lo.y / BRICK; by <= (hi.y - 1) / BRICK; ++by)
+    for (int bx = lo.x / BRICK; bx <= (hi.x - 1) / BRICK; ++bx)
+    {
+        int i = brickIndex(bx, by, bz);
+        dirty[i] = 1;
+        brickRevision[i] = stamp;
+    }
+}
+
+bool Grid::clipBox(glm::ivec3& lo, glm::ivec3& hi, const glm::ivec3& clipLo, const glm::ivec3& clipHi) const
+{
+    lo = glm::max(lo, glm::max(clipLo, glm::ivec3(0, 0, zOrigin)));
+    hi = glm::min(hi, glm::min(clipHi, glm::ivec3(size, size, zOrigin + depth)));
+    return lo.x < hi.x && lo.y < hi.y && lo.z < hi.z;
+}
+
+void Grid::fillTemperature(const glm::ivec3& lo, const glm::ivec3& hi, float degrees)
+{
+    glm::ivec3 a = lo, b = hi;
+    if (!clipBox(a, b, glm::ivec3(0), glm::ivec3(std::numeric_limits<int>::max()))) return;
+
+    auto& temperature = fields.current<CellField::TEMPERATURE>();
+    for (int z = a.z; z < b.z; ++z) {
+        for (int y = a.y; y < b.y; ++y) {
+            int row = index(0, y, z - zOrigin);
+            std::fill(temperature.begin() + row + a.x, temperature.begin() + row + b.x, degrees);
+        }
+    }
+    markRegionDirty(a, b);
+}
+
+uint8_t Grid::getMass(int x, int y, int z) const
+{
+    if (!inBounds(x, y, z)) return 0;
+    return mass[index(x, y, z)];
+}
+
+void Grid::markDirty(int x, int y, int z)
+{
+    int b = brickIndex(x / BRICK, y / BRICK, z / BRICK);
+    dirty[b] = 1;
+    brickRevision[b] = ++revision;
+}
+
+void Grid::clearDirty()
+{
+    std::fill(dirty.begin(), dirty.end(), 0);
+}
+
+void Grid::markAllDirty()
+{
+    std::fill(dirty.begin(), dirty.end(), 1);
+    std::fill(brickRevision.begin(), brickRevision.end(), ++revision);
 }
 
 void Grid::swapBuffers()
 {
     std::swap(current, next);
+    fields.swap();
+    facePlanes[0].clear();
+    facePlanes[1].clear();
 }
 
 void Grid::clear()
 {
-    std::fill(current.begin(), current.end(), Material::EMPTY);
-    std::fill(next.begin(), next.end(), Material::EMPTY);
+    current.fill(0, current.size(), Material::EMPTY);
+    next.fill(0, next.size(), Material::EMPTY);
+    std::fill(mass.begin(), mass.end(), 0);
+    fields.clear();
+    markAllDirty();
+}
+
+Grid::HaloRow Grid::haloRow(int y, int z) const
+{
+    // A border cell is decided by the last axis it lies past: a closed face's fill, or the cell across a
+    // periodic face or in the neighbouring slab, decided the same way along the earlier axes
+    const uint8_t* plane = current.data();
+    if (z < 0 || z >= depth) {
+        const std::vector<uint8_t>& face = facePlanes[z < 0 ? 0 : 1];
+        if (!face.empty()) {
+            plane = face.data();
+            z = 0;
+        } else if (wraps(2)) {
+            z = (z + depth) % depth;
+        } else {
+            return closedRow(2);
+        }
+    }
+    if (y < 0 || y >= size) {
+        if (!wraps(1)) return closedRow(1);
+        y = (y + size) % size;
+    }
+
+    HaloRow row = closedRow(0);
+    row.cells = plane + current.byteOffset(index(0, y, z));
+    if (wraps(0)) {
+        // The row's last and first cells, the last in the high nibble of the last byte when packed
+        const size_t last = current.byteOffset(size - 1);
+        row.before = (Material)(current.isPacked() ? row.cells[last] >> 4 : row.cells[last]);
+        row.after = (Material)(current.isPacked() ? row.cells[0] & 0xF : row.cells[0]);
+    }
+    return row;
+}
+
+Grid::HaloRow Grid::closedRow(int axis) const
+{
+    if (boundaries[axis] == Boundary::WALL) return {wallRow.data(), Material::WALL, Material::WALL};
+    return {emptyRow.data(), Material::EMPTY, Material::EMPTY};
+}
+
+Material Grid::haloCell(int x, int y, int z) const
+{
+    if (inBounds(x, y, z)) return current[index(x, y, z)];
+    HaloRow row = haloRow(y, z);
+    if (x < 0) return row.before;
+    if (x >= size) return row.after;
+    if (!current.isPacked()) return (Material)row.cells[x];
+    return (Material)((row.cells[x >> 1] >> ((x & 1) << 2)) & 0xF);
+}
+
+bool Grid::wrap(int& x, int& y, int& z) const
+{
+    int* c[3] = {&x, &y, &z};
+    const int extent[3] = {size, size, depth};
+    for (int axis = 0; axis < 3; ++axis) {
+        if (*c[axis] >= 0 && *c[axis] < extent[axis]) continue;
+        if (!wraps(axis)) return false;
+        *c[axis] = (*c[axis] < 0) ? *c[axis] + extent[axis] : *c[axis] - extent[axis];
+    }
+    return true;
+}
+
+uint64_t Grid::fingerprint() const
+{
+    // FNV-1a over each cell's material then the mass
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < current.size(); ++i) h = (h ^ (uint8_t)current[i]) * 1099511628211ull;
+    for (uint8_t m : mass) h = (h ^ m) * 1099511628211ull;
+    return h;
+}
+
+bool Grid::wraps(int axis) const
+{
+    return boundaries[axis] == Boundary::PERIODIC && (axis != 2 || depth == size);
+}
+
+int Grid::roundSize(int requestedSize)
+{
+    return (std::max(requestedSize, BRICK) + BRICK - 1) / BRICK * BRICK;
+}
+
+bool Grid::raycast(const glm::vec3& origin, const glm::vec3& dir, float maxDist, RayHit& hit,
+                   bool throughWalls) const
+{
+    hit.hit = false;
+    const float inf = std::numeric_limits<float>::infinity();
+
+    // Shift so voxel i spans [i, i + 1), then clip the ray to the grid, a slab only as deep as its layers
+    glm::vec3 o = origin + 0.5f;
+    const glm::ivec3 extent(size, size, depth);
+    float tEnter = 0.0f;
+    float tExit = maxDist;
+    int enterAxis = -1;
+    for (int a = 0; a < 3; ++a) {
+        if (dir[a] == 0.0f) {
+            if (o[a] < 0.0f || o[a] >= extent[a]) return false;
+            continue;
+        }
+        float t0 = (0.0f - o[a]) / dir[a];
+        float t1 = ((float)extent[a] - o[a]) / dir[a];
+        if (t0 > t1) std::swap(t0, t1);
+        if (t0 > tEnter) {
+            tEnter = t0;
+            enterAxis = a;
+        }
+        tExit = std::min(tExit, t1);
+    }
+    if (tEnter > tExit) return false;
+
+    // Amanatides-Woo traversal: always step across the nearest cell boundary
+    glm::vec3 start = o + dir * tEnter;
+    glm::ivec3 cell, step, normal(0);
+    glm::vec3 tMax, tDelta;
+    for (int a = 0; a < 3; ++a) {
+        cell[a] = std::clamp((int)std::floor(start[a]), 0, extent[a] - 1);
+        step[a] = (dir[a] > 0.0f) - (dir[a] < 0.0f);
+        tDelta[a] = step[a] ? std::abs(1.0f / dir[a]) : inf;
+        tMax[a] = step[a] ? (cell[a] + (step[a] > 0) - o[a]) / dir[a] : inf;
+    }
+    if (enterAxis >= 0) normal[enterAxis] = -step[enterAxis];
+
+    float t = tEnter;
+    while (t <= tExit) {
+        Material m = current[index(cell.x, cell.y, cell.z)];
+        if (m != Material::EMPTY && !(throughWalls && m == Material::WALL)) {
+            hit = {true, cell, normal, t, m};
+            return true;
+        }
+
+        int a = (tMax.x < tMax.y) ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+        t = tMax[a];
+        cell[a] += step[a];
+        tMax[a] += tDelta[a];
+        normal = glm::ivec3(0);
+        normal[a] = -step[a];
+        if (cell[a] < 0 || cell[a] >= extent[a]) return false;
+    }
+    return false;
+}
+
+void Grid::raycast(const std::vector<Ray>& rays, float maxDist, std::vector<RayHit>& hits) const
+{
+    hits.resize(rays.size());
+    for (size_t i = 0; i < rays.size(); ++i) {
+        raycast(rays[i].origin, rays[i].dir, maxDist, hits[i]);
+    }
 }
 
 bool Grid::inBounds(int x, int y, int z) const
 {
-    return x >= 0 && x < SIZE && y >= 0 && y < SIZE && z >= 0 && z < SIZE;
+    return x >= 0 && x < size && y >= 0 && y < size && z >= 0 && z < depth;
 }
 
 int Grid::index(int x, int y, int z) const
 {
-    return z * SIZE * SIZE + y * SIZE + x;
+    return z * size * size + y * size + x;
+}
+
+int Grid::brickIndex(int bx, int by, int bz) const
+{
+    return bz * bricks * bricks + by * bricks + bx;
 }
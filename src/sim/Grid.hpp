@@ -1,18 +1,97 @@
 #pragma once
 
+#include "CellBuffer.hpp"
+#include "CellFields.hpp"
 #include "Materials.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
 #include <vector>
 #include <glm/glm.hpp>
 
+/// \brief A ray to cast through the grid
+struct Ray
+{
+    glm::vec3 origin;
+    glm::vec3 dir;
+};
+
+/// \brief Result of a ray cast, voxel i spanning [i - 0.5, i + 0.5) on each axis
+struct RayHit
+{
+    bool hit;
+    glm::ivec3 cell;        // First non-empty cell along the ray
+    glm::ivec3 normal;      // Face the ray entered through, zero if it started inside
+    float distance;         // Entry distance in units of the ray direction's length
+    Material material;
+};
+
+/// \brief What lies beyond a pair of opposite grid faces
+enum class Boundary : uint8_t
+{
+    WALL,           // A shell of wall cells just inside the face
+    PERIODIC,       // The opposite face, so the axis wraps around
+    OPEN            // Empty space that absorbs anything leaving the grid
+};
+
+/// \brief Boundary per axis, x then y then z
+using Boundaries = std::array<Boundary, 3>;
+
 class Grid
 {
 public:
-    static constexpr int SIZE = 64;
+    static constexpr int DEFAULT_SIZE = 64;
+    static constexpr int BRICK = 8;                 // Edge length of a dirty-tracking brick
+    static constexpr uint8_t FULL_MASS = 192;       // Water mass of one uncompressed cell
+    static constexpr uint8_t MAX_MASS = 255;        // Water mass of a fully compressed cell
+
+    /// \brief Cubic voxel render grid, or a slab of one for a distributed run
+    /// \param size Edge length in cells, rounded up to a whole number of bricks
+    /// \param boundaries Boundary per axis, walls on every face by default
+    /// \param storage Byte or packed cells, packed halving the memory the state buffers take
+    /// \param zBegin First z of the full grid this grid holds, a multiple of BRICK
+    /// \param zEnd End of the z range held, -1 for the whole grid
+    /// \param cellMemory Caller-owned storage for both state buffers to use instead of allocating,
+    /// two blocks of CellBuffer::bytesFor(cells, storage) bytes one after the other, null to allocate
+    explicit Grid(int size = DEFAULT_SIZE,
+                  const Boundaries& boundaries = {Boundary::WALL, Boundary::WALL, Boundary::WALL},
+                  CellStorage storage = CellStorage::BYTE, int zBegin = 0, int zEnd = -1,
+                  uint8_t* cellMemory = nullptr);
+
+    /// \brief Get the edge length in cells, of the full grid for a slab
+    int getSize() const { return size; }
+
+    /// \brief Get the edge length in bricks
+    int getBricks() const { return bricks; }
+
+    /// \brief Get how the state buffers store their cells
+    CellStorage getStorage() const { return current.isPacked() ? CellStorage::PACKED : CellStorage::BYTE; }
+
+    /// \brief Get the number of z values held, the edge length unless this is a slab
+    int getDepth() const { return depth; }
 
-    /// \brief Cubic voxel render grid
-    Grid();
+    /// \brief Get the full grid's z of this grid's z = 0
+    /// Point accessors, indices and halo rows take z relative to it, fills take full-grid z
+    int getZOrigin() const { return zOrigin; }
+
+    /// \brief Get the boundary of an axis
+    /// \param axis 0, 1 or 2 for x, y or z
+    Boundary getBoundary(int axis) const { return boundaries[axis]; }
+
+    /// \brief Get the boundary of every axis
+    const Boundaries& getBoundaries() const { return boundaries; }
+
+    /// \brief Check if an axis wraps around within this grid
+    /// A slab's z never does, since what lies past its z faces belongs to the neighbouring slabs
+    bool wraps(int axis) const;
+
+    /// \brief Get the edge length a grid constructed with a requested size ends up with
+    static int roundSize(int requestedSize);
 
     /// \brief Get the material at a given coordinate
+    /// Outside the grid this is wall beyond wall faces, empty beyond open ones, and wraps across periodic ones,
+    /// z deciding before y and y before x past an edge or corner, just as the rules see the border
     /// \param x X-coord
     /// \param Y Y-coord
     /// \param Z Z-coord
@@ -24,18 +103,170 @@ public:
     /// \param Z Z-coord
     void set(int x, int y, int z, Material m);
 
+    /// \brief Fill the box [lo, hi) with a material, clipped to the grid
+    /// Fills take full-grid coordinates, so a slab receives only its share
+    /// \param lo Inclusive lower corner
+    /// \param hi Exclusive upper corner
+    /// \param m Material to fill with
+    /// \param clipLo Inclusive lower corner of the region edits may touch
+    /// \param clipHi Exclusive upper corner of the region edits may touch
+    void fillBox(const glm::ivec3& lo, const glm::ivec3& hi, Material m,
+                 const glm::ivec3& clipLo = glm::ivec3(0),
+                 const glm::ivec3& clipHi = glm::ivec3(std::numeric_limits<int>::max()));
+
+    /// \brief Fill every cell whose centre lies within a sphere
+    /// \param center Sphere centre
+    /// \param radius Sphere radius, zero fills only a cell centred exactly on center
+    /// \param m Material to fill with
+    /// \param clipLo Inclusive lower corner of the region edits may touch
+    /// \param clipHi Exclusive upper corner of the region edits may touch
+    void fillSphere(const glm::vec3& center, float radius, Material m,
+                    const glm::ivec3& clipLo = glm::ivec3(0),
+                    const glm::ivec3& clipHi = glm::ivec3(std::numeric_limits<int>::max()));
+
+    /// \brief Fill a brush stroke of spheres swept from a to b
+    /// \param a Stroke start
+    /// \param b Stroke end
+    /// \param radius Brush radius
+    /// \param m Material to fill with
+    /// \param clipLo Inclusive lower corner of the region edits may touch
+    /// \param clipHi Exclusive upper corner of the region edits may touch
+    void fillLine(const glm::vec3& a, const glm::vec3& b, float radius, Material m,
+                  const glm::ivec3& clipLo = glm::ivec3(0),
+                  const glm::ivec3& clipHi = glm::ivec3(std::numeric_limits<int>::max()));
+
+    /// \brief Fill each cell of the box [lo, hi) independently with a given probability
+    /// \param lo Inclusive lower corner
+    /// \param hi Exclusive upper corner
+    /// \param m Material to fill with
+    /// \param probability Chance of filling each cell
+    /// \param seed Noise seed, the same seed always fills the same cells
+    /// \param clipLo Inclusive lower corner of the region edits may touch
+    /// \param clipHi Exclusive upper corner of the region edits may touch
+    void fillNoise(const glm::ivec3& lo, const glm::ivec3& hi, Material m, float probability, uint32_t seed,
+                   const glm::ivec3& clipLo = glm::ivec3(0),
+                   const glm::ivec3& clipHi = glm::ivec3(std::numeric_limits<int>::max()));
+
+    /// \brief Copy a block of cells into the grid, empty cells included
+    /// \param origin Grid coordinate of the block's first cell
+    /// \param dims Block dimensions
+    /// \param cells Block cells, x fastest then y then z
+    /// \param clipLo Inclusive lower corner of the region edits may touch
+    /// \param clipHi Exclusive upper corner of the region edits may touch
+    void pasteVolume(const glm::ivec3& origin, const glm::ivec3& dims, const std::vector<Material>& cells,
+                     const glm::ivec3& clipLo = glm::ivec3(0),
+                     const glm::ivec3& clipHi = glm::ivec3(std::numeric_limits<int>::max()));
+
+    /// \brief Set the temperature of the box [lo, hi), clipped to the grid, allocating the field on first use.
+    /// Its bricks are flagged as changed, so conduction picks the edit up
+    /// \param lo Inclusive lower corner
+    /// \param hi Exclusive upper corner
+    /// \param degrees Temperature to set
+    void fillTemperature(const glm::ivec3& lo, const glm::ivec3& hi, float degrees);
+
+    /// \brief Get the water mass at a given coordinate
+    /// \param x X-coord
+    /// \param Y Y-coord
+    /// \param Z Z-coord
+    uint8_t getMass(int x, int y, int z) const;
+
+    /// \brief Get the water mass buffer, shared by the current and next state
+    std::vector<uint8_t>& getMassBuffer() { return mass; }
+
+    /// \brief Get the water mass buffer
+    const std::vector<uint8_t>& getMassBuffer() const { return mass; }
+
+    /// \brief Get the optional per-cell fields, swapped along with the state buffers
+    CellFields& getFields() { return fields; }
+
+    /// \brief Get the optional per-cell fields
+    const CellFields& getFields() const { return fields; }
+
+    /// \brief Flag the brick containing a cell as changed this tick
+    /// \param x X-coord
+    /// \param Y Y-coord
+    /// \param Z Z-coord
+    void markDirty(int x, int y, int z);
+
+    /// \brief Get the per-brick changed flags, indexed by brickIndex
+    const std::vector<uint8_t>& getDirtyBricks() const { return dirty; }
+
+    /// \brief Reset all brick changed flags
+    void clearDirty();
+
+    /// \brief Flag every brick as changed, after writing the buffers directly
+    void markAllDirty();
+
+    /// \brief Counter bumped on every change, used to skip redundant render updates
+    uint64_t getRevision() const { return revision; }
+
+    /// \brief Get the revision at which each brick last changed, indexed by brickIndex
+    const std::vector<uint64_t>& getBrickRevisions() const { return brickRevision; }
+
+    /// \brief Get a fingerprint of the current cells and water mass, the same for either storage
+    uint64_t fingerprint() const;
+
+    /// \brief Get a brick's index
+    int brickIndex(int bx, int by, int bz) const;
+
     /// \brief Update the new current buffer for cellular automata rule calculation from the previous
     void swapBuffers();
 
     /// \brief Get the current state buffer
-    const std::vector<Material>& getCurrentBuffer() const { return current; }
+    const CellBuffer& getCurrentBuffer() const { return current; }
+
+    /// \brief Get the current state buffer for direct writes, followed by markAllDirty
+    CellBuffer& getCurrentBuffer() { return current; }
 
     /// \brief Get the next state buffer
-    std::vector<Material>& getNextBuffer() { return next; }
+    CellBuffer& getNextBuffer() { return next; }
 
     /// \brief Clear all buffers
     void clear();
 
+    /// \brief A row of cells along x as the cells beside it see it, with the cell just past each x face
+    struct HaloRow
+    {
+        const uint8_t* cells;       // The row's size cells, in the grid's storage
+        Material before;            // Cell at x = -1
+        Material after;             // Cell at x = size
+    };
+
+    /// \brief Get a row of the current buffer or of its one-cell border, y and z from -1 to size
+    /// Rows inside the grid are read in place. A border row is the one across a periodic face, the neighbouring
+    /// slab's plane past a slab's z face, or a row of wall or empty cells past a closed face
+    HaloRow haloRow(int y, int z) const;
+
+    /// \brief Get a cell of the current buffer or of its border, each coordinate from -1 to size
+    Material haloCell(int x, int y, int z) const;
+
+    /// \brief Get the plane of cells just past a z face, taken from the neighbouring slab
+    /// Held in the grid's storage, and emptied when the buffers swap, so the face follows its boundary again
+    /// \param side 0 for the plane below z = 0, 1 for the one above the last z
+    std::vector<uint8_t>& getFacePlane(int side) { return facePlanes[side]; }
+
+    /// \brief Get the size of one z plane of cells in bytes
+    size_t getPlaneBytes() const { return current.byteCount((size_t)size * size); }
+
+    /// \brief Map a coordinate up to one cell outside the grid back across faces that wrap
+    /// \return False if it lies beyond a wall or open face
+    bool wrap(int& x, int& y, int& z) const;
+
+    /// \brief Find the first non-empty cell along a ray, visiting each crossed cell once
+    /// \param origin Ray origin in world space
+    /// \param dir Ray direction, need not be normalized
+    /// \param maxDist Furthest distance to search, in units of dir's length
+    /// \param hit Filled with the hit when one is found
+    /// \param throughWalls Pass through wall cells, which are never drawn, as if they were empty
+    bool raycast(const glm::vec3& origin, const glm::vec3& dir, float maxDist, RayHit& hit,
+                 bool throughWalls = false) const;
+
+    /// \brief Cast a batch of rays
+    /// \param rays Rays to cast
+    /// \param maxDist Furthest distance to search along each ray
+    /// \param hits Resized to one result per ray
+    void raycast(const std::vector<Ray>& rays, float maxDist, std::vector<RayHit>& hits) const;
+
     /// \brief Check if point is in bounds
     bool inBounds(int x, int y, int z) const;
 
@@ -43,7 +274,34 @@ public:
     int index(int x, int y, int z) const;
 
 private:
+    int size;                       // Edge length in cells
+    int bricks;                     // Edge length in bricks
+    int depth;                      // Z values held, size for a full grid
+    int zOrigin;                    // Full-grid z of local z = 0
+    Boundaries boundaries;
+
     // Current and next state buffers
-    std::vector<Material> current;
-    std::vector<Material> next;
+    CellBuffer current;
+    CellBuffer next;
+
+    std::vector<uint8_t> facePlanes[2]; // Neighbouring slabs' planes past the z faces, empty for none
+    CellBuffer wallRow;             // A row of walls and one of empty cells, for border rows past closed faces
+    CellBuffer emptyRow;
+    std::vector<uint8_t> mass;      // Water mass per cell, single buffered
+    CellFields fields;
+    std::vector<uint8_t> dirty;     // Per-brick changed flags
+    std::vector<uint64_t> brickRevision;
+    std::atomic<uint64_t> revision; // Atomic so disjoint regions can be filled concurrently
+
+    // Get the border row past a closed face of an axis, all wall or all empty
+    HaloRow closedRow(int axis) const;
+
+    // Fill cells [x0, x1) of one row, which must already be clipped, at full-grid z
+    void fillRow(int y, int z, int x0, int x1, Material m);
+
+    // Mark every brick overlapping the clipped box [lo, hi) as changed
+    void markRegionDirty(const glm::ivec3& lo, const glm::ivec3& hi);
+
+    // Intersect a full-grid box with the cells held and a clip region, false if nothing is left
+    bool clipBox(glm::ivec3& lo, glm::ivec3& hi, const glm::ivec3& clipLo, const glm::ivec3& clipHi) const;
 };
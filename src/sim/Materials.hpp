@@ -20,6 +20,7 @@ struct MaterialInfo
     glm::vec3 color;
     bool gravity;
     bool fluid;
+    float conductivity;     // How readily heat crosses a face, from 0 to 1
 };
 
 /// \brief Getter to access a material's properties
@@ -27,15 +28,33 @@ constexpr MaterialInfo getMaterialInfo(Material m)
 {
     switch (m) {
         case Material::SAND:
-            return {{0.9f, 0.8f, 0.3f}, true, false};
+            return {{0.9f, 0.8f, 0.3f}, true, false, 0.3f};
         case Material::WATER:
-            return {{0.2f, 0.6f, 1.0f}, true, true};
+            return {{0.2f, 0.6f, 1.0f}, true, true, 0.6f};
         case Material::GOL:
-            return {{0.0f, 1.0f, 0.0f}, false, false};
+            return {{0.0f, 1.0f, 0.0f}, false, false, 0.4f};
         case Material::WALL:
-            return {{0.5f, 0.5f, 0.5f}, false, false};
+            return {{0.5f, 0.5f, 0.5f}, false, false, 0.1f};
         case Material::EMPTY:
         default:
-            return {{0.0f, 0.0f, 0.0f}, false, false};
+            return {{0.0f, 0.0f, 0.0f}, false, false, 0.05f};
+    }
+}
+
+/// \brief Getter for a material's lowercase name, as used in scene files
+constexpr const char* getMaterialName(Material m)
+{
+    switch (m) {
+        case Material::SAND:
+            return "sand";
+        case Material::WATER:
+            return "water";
+        case Material::GOL:
+            return "gol";
+        case Material::WALL:
+            return "wall";
+        case Material::EMPTY:
+        default:
+            return "empty";
     }
 }
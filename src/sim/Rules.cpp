@@ -1,131 +1,951 @@
 #include "Rules.hpp"
-#include <random>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 
 namespace {
-    std::mt19937 rng(42);
+    constexpr int COMPRESS = 2;     // Extra mass a cell holds per full cell stacked above it
+    constexpr int MIN_FLOW = 4;     // Smallest lateral mass difference worth equalizing
+
+    // Mass the lower of two stacked cells holds once settled, given their combined mass
+    int stableBottom(int total)
+    {
+        const int full = Grid::FULL_MASS;
+        if (total <= full) return total;
+        if (total < 2 * full + COMPRESS) {
+            return (full * full + total * COMPRESS) / (full + COMPRESS);
+        }
+        return std::min((total + COMPRESS) / 2, (int)Grid::MAX_MASS);
+    }
+
+    bool isOpen(Material m)
+    {
+        return m == Material::EMPTY || m == Material::WATER;
+    }
+
+    // Wake every brick flagged in dirty, along with its 26 neighbours, across periodic faces too.
+    // The layers of flags just below and above a slab wake its own end layers, empty for none
+    std::vector<uint8_t> dilateBricks(const Grid& grid, const std::vector<uint8_t>& dirty,
+                                      const std::vector<uint8_t>& below, const std::vector<uint8_t>& above)
+    {
+        std::vector<uint8_t> active(dirty.size(), 0);
+        const int bricks = grid.getBricks();
+        const glm::ivec3 extent(bricks, bricks, grid.getDepth() / Grid::BRICK);
+        const int layer = bricks * bricks;
+        for (int bz = -1; bz <= extent.z; ++bz) {
+            const std::vector<uint8_t>& source = (bz < 0) ? below : (bz == extent.z) ? above : dirty;
+            if (source.empty()) continue;
+            const uint8_t* flags = (bz < 0 || bz == extent.z) ? source.data() : &dirty[bz * layer];
+
+            for (int by = 0; by < bricks; ++by)
+            for (int bx = 0; bx < bricks; ++bx)
+            {
+                if (!flags[by * bricks + bx]) continue;
+
+                for (int dz = -1; dz <= 1; ++dz)
+                for (int dy = -1; dy <= 1; ++dy)
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    glm::ivec3 n(bx + dx, by + dy, bz + dz);
+                    bool inside = true;
+                    for (int axis = 0; axis < 3; ++axis) {
+                        if (n[axis] >= 0 && n[axis] < extent[axis]) continue;
+                        inside = inside && grid.wraps(axis);
+                        n[axis] = (n[axis] + extent[axis]) % extent[axis];
+                    }
+                    if (inside) active[grid.brickIndex(n.x, n.y, n.z)] = 1;
+                }
+            }
+        }
+        return active;
+    }
+
+    // Pick one of four sand slides from the seed, tick and full-grid cell alone, so any split of
+    // the grid, or any order of visiting its cells, picks the same one
+    int slideDirection(uint32_t seed, uint64_t tick, int x, int y, int z)
+    {
+        uint64_t h = ((uint64_t)seed << 32) ^ tick;
+        h ^= ((uint64_t)(uint32_t)x * 73856093u) ^ ((uint64_t)(uint32_t)y * 19349663u << 16)
+           ^ ((uint64_t)(uint32_t)z * 83492791u << 32);
+        h ^= h >> 33; h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return (int)(h & 3);
+    }
+
+    // Cell x of a halo row, from -1 to size, in byte or packed storage
+    Material byteCell(const Grid::HaloRow& row, int x, int size)
+    {
+        return x < 0 ? row.before : x >= size ? row.after : (Material)row.cells[x];
+    }
+
+    Material packedCell(const Grid::HaloRow& row, int x, int size)
+    {
+        if (x < 0) return row.before;
+        if (x >= size) return row.after;
+        return (Material)((row.cells[x >> 1] >> ((x & 1) << 2)) & 0xF);
+    }
+
+    // Cells 16w to 16w + 15 of a packed halo row as one word. Sizes are whole bricks, so the last word of
+    // a row may hold only 8 cells, and then the cell past the x face follows them
+    uint64_t packedWord(const Grid::HaloRow& row, int w, int size)
+    {
+        uint64_t word = 0;
+        if (size - 16 * w >= 16) {
+            std::memcpy(&word, row.cells + 8 * w, 8);
+        } else {
+            std::memcpy(&word, row.cells + 8 * w, 4);
+            word |= (uint64_t)row.after << 32;
+        }
+        return word;
+    }
+
+    // Exchange water mass between two neighbouring cells, true if either changed
+    bool flow(Material& cellA, uint8_t& massA, Material& cellB, uint8_t& massB, bool vertical)
+    {
+        int a = massA;
+        int b = massB;
+        if (a == 0 && b == 0) return false;
+        if (!isOpen(cellA) || !isOpen(cellB)) return false;
+
+        // Vertical pairs settle under gravity and pressure, lateral pairs level out
+        int total = a + b;
+        int na;
+        if (vertical) {
+            na = stableBottom(total);
+        } else {
+            if (std::abs(a - b) <= MIN_FLOW) return false;
+            int half = total / 2;
+            na = (a > b) ? total - half : half;
+        }
+        if (na == a) return false;
+
+        int nb = total - na;
+        massA = (uint8_t)na;
+        massB = (uint8_t)nb;
+        cellA = na > 0 ? Material::WATER : Material::EMPTY;
+        cellB = nb > 0 ? Material::WATER : Material::EMPTY;
+        return true;
+    }
+
+    // Move heat along with the water mass flow() moved between two cells. The water trades places with as much
+    // of the other cell, so heat is conserved and a full cell moving into an empty one swaps heat with it
+    void carryHeat(float& heatA, float& heatB, int moved)
+    {
+        float share = std::min((float)std::abs(moved) / Grid::FULL_MASS, 1.0f);
+        float traded = (heatB - heatA) * share;
+        heatA += traded;
+        heatB -= traded;
+    }
+
+    // flow() over n pairs at once, the first cells at a[k * step] and the second at b[k * step], with no branch
+    // on their contents so the loop vectorizes. Sets changed[k] for every pair whose mass moved, and carries
+    // the heat of each pair along as carryHeat would when CarriesHeat
+    template <bool CarriesHeat>
+    void flowPairs(uint8_t* cellA, uint8_t* massA, uint8_t* cellB, uint8_t* massB, float* heatA, float* heatB,
+                   int n, int step, bool vertical, uint8_t* changed)
+    {
+        const int full = Grid::FULL_MASS;
+        const int empty = (int)Material::EMPTY;
+        const int water = (int)Material::WATER;
+        for (int k = 0; k < n; ++k) {
+            const int ca = cellA[k * step], cb = cellB[k * step];
+            const int a = massA[k * step], b = massB[k * step];
+            const int total = a + b;
+
+            // stableBottom and the lateral split, each as selects between their cases
+            const int settled = total <= full ? total
+                              : total < 2 * full + COMPRESS ? (full * full + total * COMPRESS) / (full + COMPRESS)
+                              : std::min((total + COMPRESS) / 2, (int)Grid::MAX_MASS);
+            const int half = total >> 1;
+            const int levelled = std::max(a, b) - std::min(a, b) > MIN_FLOW ? (a > b ? total - half : half) : a;
+            const bool open = (ca == empty || ca == water) && (cb == empty || cb == water);
+
+            const int na = open ? (vertical ? settled : levelled) : a;
+            const int nb = total - na;
+            const bool moved = na != a;
+            massA[k * step] = (uint8_t)na;
+            massB[k * step] = (uint8_t)nb;
+            cellA[k * step] = (uint8_t)(moved ? (na > 0 ? water : empty) : ca);
+            cellB[k * step] = (uint8_t)(moved ? (nb > 0 ? water : empty) : cb);
+            changed[k] = moved;
+            if (CarriesHeat) {
+                const float share = std::min((float)std::abs(a - na) / full, 1.0f);
+                const float traded = (heatB[k * step] - heatA[k * step]) * share;
+                heatA[k * step] += traded;
+                heatB[k * step] -= traded;
+            }
+        }
+    }
+
 }
 
+bool RuleSet::parse(const std::string& text, RuleSet& out)
+{
+    // Collect the counts listed after one of the section letters
+    auto readCounts = [&text](char section, uint32_t& mask) {
+        size_t start = text.find(section);
+        if (start == std::string::npos) return false;
+
+        mask = 0;
+        size_t i = start + 1;
+        while (i < text.size() && text[i] != '/') {
+            size_t end = i;
+            int lo = 0;
+            while (end < text.size() && std::isdigit((unsigned char)text[end])) lo = lo * 10 + (text[end++] - '0');
+            if (end == i) return false;
+            int hi = lo;
+            if (end < text.size() && text[end] == '-') {
+                size_t j = ++end;
+                hi = 0;
+                while (end < text.size() && std::isdigit((unsigned char)text[end])) hi = hi * 10 + (text[end++] - '0');
+                if (end == j) return false;
+            }
+            if (lo > hi || hi > 26) return false;
+            for (int n = lo; n <= hi; ++n) mask |= 1u << n;
+            i = (end < text.size() && text[end] == ',') ? end + 1 : end;
+            if (i < text.size() && text[i] != '/' && !std::isdigit((unsigned char)text[i])) return false;
+        }
+        return true;
+    };
+
+    RuleSet parsed;
+    if (!readCounts('S', parsed.golSurvive) || !readCounts('B', parsed.golBirth)) return false;
+    out = parsed;
+    return true;
+}
+
+std::string RuleSet::toString() const
+{
+    // Write set bits as comma separated counts, merging runs into ranges
+    auto writeCounts = [](uint32_t mask) {
+        std::string s;
+        for (int n = 0; n <= 26; ++n) {
+            if (!(mask >> n & 1)) continue;
+            int end = n;
+            while (end < 26 && (mask >> (end + 1) & 1)) ++end;
+            if (!s.empty()) s += ',';
+            s += std::to_string(n);
+            if (end > n) s += '-' + std::to_string(end);
+            n = end;
+        }
+        return s;
+    };
+    return "S" + writeCounts(golSurvive) + "/B" + writeCounts(golBirth);
+}
+
+Rules::Rules(const RuleSet& ruleSet, uint32_t seed)
+    : ruleSet(ruleSet), seed(seed), tick(0), restless(false), decomposition(nullptr),
+      tracksVelocity(false), tracksHeat(false), tracksAge(false) {}
+
 void Rules::update(Grid& grid)
 {
+    ++tick;
+    CellFields& fields = grid.getFields();
+    if (!decomposition && !fields.any() && cycle.replay(grid)) return;
+    restless = false;
+
+    // Only bricks near last tick's changes can change this tick
+    std::vector<uint8_t> active = activeBricks(grid);
+    grid.clearDirty();
+
     // Copy current to next
     grid.getNextBuffer() = grid.getCurrentBuffer();
 
-    // Iterate in deterministic order: z -> y -> x
-    for (int z = 0; z < Grid::SIZE; ++z) {
-        for (int y = Grid::SIZE - 1; y >= 0; --y) {
-            for (int x = 0; x < Grid::SIZE; ++x) {
-                Material m = grid.get(x, y, z);
+    // Sand that moves this tick writes its step, everything else stands still
+    tracksVelocity = fields.has(CellField::VELOCITY_X);
+    if (tracksVelocity) {
+        std::fill(fields.next<CellField::VELOCITY_X>().begin(), fields.next<CellField::VELOCITY_X>().end(), 0);
+        std::fill(fields.next<CellField::VELOCITY_Y>().begin(), fields.next<CellField::VELOCITY_Y>().end(), 0);
+        std::fill(fields.next<CellField::VELOCITY_Z>().begin(), fields.next<CellField::VELOCITY_Z>().end(), 0);
+    }
+
+    // Everything ages a tick unless updateAge finds it moved or changed
+    tracksAge = fields.has(CellField::AGE);
+    if (tracksAge) {
+        const auto& age = fields.current<CellField::AGE>();
+        auto& next = fields.next<CellField::AGE>();
+        for (size_t i = 0; i < age.size(); ++i) {
+            next[i] = (uint16_t)std::min(age[i] + 1, 0xFFFF);
+        }
+    }
 
-                if (m == Material::SAND) {
-                    updateSand(grid, x, y, z);
-                } else if (m == Material::WATER) {
-                    updateWater(grid, x, y, z);
+    // Neighbours are read in place, with rows past the faces resolved from the boundaries,
+    // or from the neighbouring slabs' nearest planes past a slab's z faces
+    if (decomposition) {
+        exchangeHaloPlanes(grid);
+        const size_t plane = (size_t)grid.getSize() * grid.getSize();
+        landedFrom[0].assign(plane, -1);
+        landedFrom[1].assign(plane, -1);
+    }
+
+    // Heat conducts between the cells as they stand, then every move below carries it along
+    tracksHeat = fields.has(CellField::TEMPERATURE);
+    if (tracksHeat) updateTemperature(grid, active);
+
+    if (grid.getStorage() == CellStorage::PACKED) {
+        updatePackedCells(grid, active);
+    } else {
+        updateCells(grid, active);
+    }
+
+    // Sand from neighbouring slabs lands, water flows around the solids' new positions,
+    // then drains out of open faces
+    if (decomposition) deliverSand(grid);
+    updateFluid(grid, active);
+    if (decomposition) exchangeFluid(grid, active);
+    drainOpenFaces(grid, active);
+    if (fields.any()) updateFields(grid);
+
+    grid.swapBuffers();
+
+    // Random sand slides make a repeat coincidental, so only deterministic ticks count
+    if (!decomposition) cycle.observe(grid, !restless);
+}
+
+std::vector<uint8_t> Rules::activeBricks(Grid& grid)
+{
+    std::vector<uint8_t> below, above;
+    if (decomposition) {
+        const auto& dirty = grid.getDirtyBricks();
+        const size_t layer = (size_t)grid.getBricks() * grid.getBricks();
+        std::vector<uint8_t> bottom(dirty.begin(), dirty.begin() + layer);
+        std::vector<uint8_t> top(dirty.end() - layer, dirty.end());
+        decomposition->shift(0, bottom, above);
+        decomposition->shift(1, top, below);
+    }
+    std::vector<uint8_t> active = dilateBricks(grid, grid.getDirtyBricks(), below, above);
+
+    // Sand that passed up a slide can take it on a later tick without anything near it changing
+    if (restlessBricks.size() == active.size()) {
+        for (size_t b = 0; b < active.size(); ++b) active[b] |= restlessBricks[b];
+    }
+    restlessBricks.assign(active.size(), 0);
+    return active;
+}
+
+void Rules::updateCells(Grid& grid, const std::vector<uint8_t>& active)
+{
+    const int size = grid.getSize();
+    const uint8_t gol = (uint8_t)Material::GOL;
+
+    // Iterate in deterministic order: z -> y -> x. A brick with nothing changed around it since it last
+    // updated would do the same nothing again, so only active bricks are visited
+    for (int z = 0; z < grid.getDepth(); ++z) {
+        for (int y = size - 1; y >= 0; --y) {
+            const uint8_t* brickRow = &active[grid.brickIndex(0, y / Grid::BRICK, z / Grid::BRICK)];
+
+            // The 3x3 rows around this one, -z first and -y first within each z
+            Grid::HaloRow rows[9];
+            for (int dz = -1; dz <= 1; ++dz) {
+                for (int dy = -1; dy <= 1; ++dy) {
+                    rows[(dz + 1) * 3 + dy + 1] = grid.haloRow(y + dy, z + dz);
                 }
-                else {
-                    updateGOL(m, grid, x, y, z);
+            }
+
+            for (int bx = 0; bx < grid.getBricks(); ++bx) {
+                if (!brickRow[bx]) continue;
+                for (int x = bx * Grid::BRICK; x < (bx + 1) * Grid::BRICK; ++x) {
+                    Material m = (Material)rows[4].cells[x];
+
+                    if (m == Material::SAND) {
+                        const Material below[5] = {byteCell(rows[3], x, size), byteCell(rows[3], x + 1, size),
+                                                   byteCell(rows[3], x - 1, size), byteCell(rows[6], x, size),
+                                                   byteCell(rows[0], x, size)};
+                        updateSand(grid, x, y, z, below);
+                    } else if (m != Material::WATER) {
+                        // Count neighbors, the rows' border cells standing in for whatever lies past the x faces
+                        int count = -(m == Material::GOL);
+                        if (x > 0 && x < size - 1) {
+                            for (const Grid::HaloRow& r : rows) {
+                                count += (r.cells[x - 1] == gol) + (r.cells[x] == gol) + (r.cells[x + 1] == gol);
+                            }
+                        } else {
+                            for (const Grid::HaloRow& r : rows) {
+                                for (int dx = -1; dx <= 1; ++dx) count += byteCell(r, x + dx, size) == Material::GOL;
+                            }
+                        }
+                        updateGOL(m, grid, x, y, z, count);
+                    }
                 }
             }
         }
     }
+}
 
-    grid.swapBuffers();
+void Rules::updatePackedCells(Grid& grid, const std::vector<uint8_t>& active)
+{
+    using namespace Packed;
+    CellBuffer& next = grid.getNextBuffer();
+    const int size = grid.getSize();
+    const int words = (size + 15) / 16;
+
+    // Cells with no live neighbours and nothing to move only change if life can start from nothing
+    const bool spontaneous = ruleSet.golBirth & 1;
+
+    // Same order and bricks as updateCells, sixteen cells of a row, two bricks, at a time
+    for (int z = 0; z < grid.getDepth(); ++z) {
+        for (int y = size - 1; y >= 0; --y) {
+            const uint8_t* brickRow = &active[grid.brickIndex(0, y / Grid::BRICK, z / Grid::BRICK)];
+
+            // The 3x3 rows around this one, -z first and -y first within each z
+            Grid::HaloRow rows[9];
+            for (int dz = -1; dz <= 1; ++dz) {
+                for (int dy = -1; dy <= 1; ++dy) {
+                    rows[(dz + 1) * 3 + dy + 1] = grid.haloRow(y + dy, z + dz);
+                }
+            }
+
+            for (int w = 0; w < words; ++w) {
+                // Lanes 0 to 7 lie in brick 2w and the rest in brick 2w + 1, which a grid of an odd number of bricks lacks
+                const int lanes = std::min(16, size - 16 * w);
+                const int first = brickRow[2 * w] ? 0 : Grid::BRICK;
+                const int last = (lanes > Grid::BRICK && brickRow[2 * w + 1]) ? lanes : Grid::BRICK;
+                if (first >= last) continue;
+
+                // Cells 16w to 16w + 15 of each row, with their x neighbours either side.
+                // Live flags split into even and odd cells, a byte lane each, so sums of up to 27 fit
+                uint64_t evenCount = 0, oddCount = 0;
+                for (const Grid::HaloRow& r : rows) {
+                    uint64_t live = match(packedWord(r, w, size), Material::GOL);
+                    uint64_t even = live & EVEN_NIBBLES;
+                    uint64_t odd = (live >> 4) & EVEN_NIBBLES;
+                    uint64_t left = (odd << 8) | (uint64_t)(packedCell(r, 16 * w - 1, size) == Material::GOL);
+                    uint64_t right = (even >> 8) | ((uint64_t)(packedCell(r, 16 * w + 16, size) == Material::GOL) << 56);
+                    evenCount += even + odd + left;
+                    oddCount += odd + even + right;
+                }
+
+                const uint64_t center = packedWord(rows[4], w, size);
+                const uint64_t self = match(center, Material::GOL);
+                evenCount -= self & EVEN_NIBBLES;
+                oddCount -= (self >> 4) & EVEN_NIBBLES;
+                if (!(evenCount | oddCount | self | match(center, Material::SAND)) && !spontaneous) continue;
+
+                // Sand moves a grain at a time, while Game of Life births and deaths gather into nibble masks
+                // and land in the next buffer as one word, only ever touching the cells of this row they decide
+                uint64_t born = 0, died = 0;
+                for (int i = first; i < last; ++i) {
+                    const int x = 16 * w + i;
+                    Material m = lane(center, i);
+                    if (m == Material::SAND) {
+                        // Below, then the +x, -x, +z and -z diagonals
+                        const Material below[5] = {packedCell(rows[3], x, size), packedCell(rows[3], x + 1, size),
+                                                   packedCell(rows[3], x - 1, size), packedCell(rows[6], x, size),
+                                                   packedCell(rows[0], x, size)};
+                        updateSand(grid, x, y, z, below);
+                    } else if (m == Material::GOL || m == Material::EMPTY) {
+                        int count = (int)((((i & 1) ? oddCount : evenCount) >> ((i >> 1) << 3)) & 0xFF);
+                        if (m == Material::GOL && !(ruleSet.golSurvive >> count & 1)) died |= 0xFull << (i << 2);
+                        if (m == Material::EMPTY && (ruleSet.golBirth >> count & 1)) born |= 0xFull << (i << 2);
+                    }
+                }
+                if (!(born | died)) continue;
+
+                uint8_t* out = next.data() + next.byteOffset(grid.index(16 * w, y, z));
+                uint64_t word = 0;
+                std::memcpy(&word, out, lanes / 2);
+                word = (word & ~(born | died)) | (born & (LOW_BITS * (uint64_t)Material::GOL));
+                std::memcpy(out, &word, lanes / 2);
+                if ((born | died) & 0xFFFFFFFFull) grid.markDirty(16 * w, y, z);
+                if ((born | died) >> 32) grid.markDirty(16 * w + Grid::BRICK, y, z);
+            }
+        }
+    }
 }
 
-void Rules::updateSand(Grid& grid, int x, int y, int z)
+void Rules::exchangeHaloPlanes(Grid& grid)
 {
-    if (y == 0) return;
+    // Planes go without a border, since every slab shares the boundaries that resolve it
+    const CellBuffer& cells = grid.getCurrentBuffer();
+    const size_t bytes = grid.getPlaneBytes();
+    const uint8_t* bottom = cells.data();
+    const uint8_t* top = cells.data() + cells.byteOffset(grid.index(0, 0, grid.getDepth() - 1));
 
-    Material below = grid.get(x, y - 1, z);
-    if (below == Material::EMPTY) {
-        grid.getNextBuffer()[grid.index(x, y - 1, z)] = Material::SAND;
-        grid.getNextBuffer()[grid.index(x, y, z)] = Material::EMPTY;
-        return;
+    std::vector<uint8_t> out(bottom, bottom + bytes);
+    decomposition->shift(0, out, grid.getFacePlane(1));
+    out.assign(top, top + bytes);
+    decomposition->shift(1, out, grid.getFacePlane(0));
+    for (int side = 0; side < 2; ++side) {
+        if (grid.getFacePlane(side).size() != bytes) grid.getFacePlane(side).clear();
     }
+}
 
-    // Try diagonal slides
-    std::uniform_int_distribution<int> dist(0, 3);
-    int dir = dist(rng);
+void Rules::deliverSand(Grid& grid)
+{
+    // Sand leaving downwards lands on the top layer of the slab below, and the other way round
+    auto& cells = grid.getNextBuffer();
+    CellFields& fields = grid.getFields();
+    std::vector<Crossing> in;
+    std::vector<float> returned, back;
+    for (int side = 0; side < 2; ++side) {
+        decomposition->shift(side, crossing[side], in);
+        crossing[side].clear();
+
+        int z = side ? 0 : grid.getDepth() - 1;
+        const std::vector<int>& landed = landedFrom[side ? 0 : 1];
+        returned.clear();
+        for (const Crossing& c : in) {
+            // Otherwise the target's own update came later and a Game of Life birth there stands
+            int target = grid.index(c.x, c.y, z);
+            int first = landed[c.y * grid.getSize() + c.x];
+            bool last = c.overwrites || first < 0;
+            if (c.overwrites || cells[target] != Material::GOL) cells.set(target, Material::SAND);
+            grid.markDirty(c.x, c.y, z);
+            if (tracksAge) fields.next<CellField::AGE>()[target] = 0;
+
+            // The grain swaps heat with whatever stood in the target before it, which for a grain coming first
+            // is the cell the first grain from this slab left with the target's heat
+            if (tracksHeat) {
+                auto& temperature = fields.next<CellField::TEMPERATURE>();
+                float& before = temperature[last ? target : first];
+                returned.push_back(before);
+                before = c.temperature;
+            }
 
-    if (dir == 0 && grid.get(x + 1, y - 1, z) == Material::EMPTY) {
-        grid.getNextBuffer()[grid.index(x + 1, y - 1, z)] = Material::SAND;
-        grid.getNextBuffer()[grid.index(x, y, z)] = Material::EMPTY;
-    } else if (dir == 1 && grid.get(x - 1, y - 1, z) == Material::EMPTY) {
-        grid.getNextBuffer()[grid.index(x - 1, y - 1, z)] = Material::SAND;
-        grid.getNextBuffer()[grid.index(x, y, z)] = Material::EMPTY;
-    } else if (dir == 2 && grid.get(x, y - 1, z + 1) == Material::EMPTY) {
-        grid.getNextBuffer()[grid.index(x, y - 1, z + 1)] = Material::SAND;
-        grid.getNextBuffer()[grid.index(x, y, z)] = Material::EMPTY;
-    } else if (dir == 3 && grid.get(x, y - 1, z - 1) == Material::EMPTY) {
-        grid.getNextBuffer()[grid.index(x, y - 1, z - 1)] = Material::SAND;
-        grid.getNextBuffer()[grid.index(x, y, z)] = Material::EMPTY;
+            // Sand only crosses slabs falling a cell while sliding along z
+            if (tracksVelocity && last) {
+                fields.next<CellField::VELOCITY_Y>()[target] = -1;
+                fields.next<CellField::VELOCITY_X>()[target] = 0;
+                fields.next<CellField::VELOCITY_Z>()[target] = (int8_t)(side ? 1 : -1);
+            }
+        }
+
+        // The heat each grain swapped out goes back to the cell it left
+        if (tracksHeat) {
+            decomposition->shift(1 - side, returned, back);
+            auto& temperature = fields.next<CellField::TEMPERATURE>();
+            for (size_t k = 0; k < back.size() && k < crossingSource[side].size(); ++k) {
+                temperature[crossingSource[side][k]] = back[k];
+            }
+        }
+        crossingSource[side].clear();
     }
 }
 
-void Rules::updateWater(Grid& grid, int x, int y, int z)
+void Rules::exchangeFluid(Grid& grid, const std::vector<uint8_t>& active)
 {
-    if (y == 0) return;
+    // Slabs start on even z, so only the odd z phase pairs cells across their faces, and
+    // each pair is settled by the slab holding its lower cell, as updateFluid would
+    auto& mass = grid.getMassBuffer();
+    auto& cells = grid.getNextBuffer();
+    const int size = grid.getSize();
+    const int top = grid.getDepth() - 1;
+    const size_t plane = (size_t)size * size;
 
-    Material below = grid.get(x, y - 1, z);
-    
-    // Always try to fall first
-    if (below == Material::EMPTY) {
-        grid.getNextBuffer()[grid.index(x, y - 1, z)] = Material::WATER;
-        grid.getNextBuffer()[grid.index(x, y, z)] = Material::EMPTY;
+    // The bottom layer goes down as cells, mass and any heat, settled by the slab below and sent back up
+    float* temperature = tracksHeat ? grid.getFields().next<CellField::TEMPERATURE>().data() : nullptr;
+    const size_t heatBytes = tracksHeat ? plane * sizeof(float) : 0;
+    std::vector<uint8_t> out(2 * plane + heatBytes), ghost, back;
+    for (size_t i = 0; i < plane; ++i) {
+        out[i] = (uint8_t)cells[i];
+    }
+    std::memcpy(out.data() + plane, mass.data(), plane);
+    if (tracksHeat) std::memcpy(out.data() + 2 * plane, temperature, heatBytes);
+    decomposition->shift(0, out, ghost);
+
+    if (ghost.size() == out.size()) {
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                if (!active[grid.brickIndex(x / Grid::BRICK, y / Grid::BRICK, top / Grid::BRICK)]) continue;
+                int i = grid.index(x, y, top);
+                int j = y * size + x;
+                Material below = cells[i];
+                Material above = (Material)ghost[j];
+                int massBelow = mass[i];
+                if (!flow(below, mass[i], above, ghost[plane + j], false)) continue;
+                cells.set(i, below);
+                ghost[j] = (uint8_t)above;
+                grid.markDirty(x, y, top);
+                if (tracksHeat) {
+                    float heatAbove;
+                    uint8_t* slot = &ghost[2 * plane + j * sizeof(float)];
+                    std::memcpy(&heatAbove, slot, sizeof(float));
+                    carryHeat(temperature[i], heatAbove, massBelow - mass[i]);
+                    std::memcpy(slot, &heatAbove, sizeof(float));
+                }
+            }
+        }
+    }
+
+    decomposition->shift(1, ghost, back);
+    if (back.size() != out.size()) return;
+    for (size_t i = 0; i < plane; ++i) {
+        if (back[plane + i] == mass[i]) continue;
+        cells.set(i, (Material)back[i]);
+        mass[i] = back[plane + i];
+        if (tracksHeat) std::memcpy(&temperature[i], &back[2 * plane + i * sizeof(float)], sizeof(float));
+        grid.markDirty((int)(i % size), (int)(i / size), 0);
+    }
+}
+
+void Rules::move(Grid& grid, Material m, int x, int y, int z, int nx, int ny, int nz)
+{
+    // Leaving through an open face drops the material, a periodic face brings it in opposite, and
+    // a slab's z face hands it to the neighbouring slab, which lands it once every slab has updated
+    // A grain swaps heat with the empty cell it lands in, and lands with a fresh age
+    int side = (nz < 0) ? 0 : (nz >= grid.getDepth()) ? 1 : -1;
+    int source = grid.index(x, y, z);
+    CellFields& fields = grid.getFields();
+    if (decomposition && side >= 0 && decomposition->getNeighbour(side) >= 0) {
+        int inside = z;
+        if (grid.wrap(nx, ny, inside)) {
+            const int size = grid.getSize();
+            int from = z + grid.getZOrigin();
+            int to = (nz + grid.getZOrigin() + size) % size;
+            float heat = tracksHeat ? fields.next<CellField::TEMPERATURE>()[source] : 0.0f;
+            crossing[side].push_back({(uint16_t)nx, (uint16_t)ny, (uint8_t)(to < from), heat});
+            crossingSource[side].push_back(source);
+        }
+    } else {
+        int dx = nx - x, dy = ny - y, dz = nz - z;
+        if (grid.wrap(nx, ny, nz)) {
+            int i = grid.index(nx, ny, nz);
+            grid.getNextBuffer().set(i, m);
+            grid.markDirty(nx, ny, nz);
+            if (tracksVelocity) {
+                fields.next<CellField::VELOCITY_X>()[i] = (int8_t)dx;
+                fields.next<CellField::VELOCITY_Y>()[i] = (int8_t)dy;
+                fields.next<CellField::VELOCITY_Z>()[i] = (int8_t)dz;
+            }
+            if (tracksHeat) {
+                auto& temperature = fields.next<CellField::TEMPERATURE>();
+                std::swap(temperature[i], temperature[source]);
+            }
+            if (tracksAge) fields.next<CellField::AGE>()[i] = 0;
+
+            // Sand crossing into the slab later needs to know what landed here before it in serial order
+            if (decomposition && (nz == 0 || nz == grid.getDepth() - 1)) {
+                int& first = landedFrom[nz == 0 ? 0 : 1][ny * grid.getSize() + nx];
+                if (first < 0) first = source;
+            }
+        }
+    }
+    grid.getNextBuffer().set(source, Material::EMPTY);
+    grid.markDirty(x, y, z);
+}
+
+void Rules::updateSand(Grid& grid, int x, int y, int z, const Material below[5])
+{
+    if (below[0] == Material::EMPTY) {
+        move(grid, Material::SAND, x, y, z, x, y - 1, z);
         return;
     }
 
-    // Only flow laterally if blocked below
-    std::uniform_int_distribution<int> dist(0, 3);
-    int dir = dist(rng);
+    // Try diagonal slides
+    int dir = slideDirection(seed, tick, x, y, z + grid.getZOrigin());
+
+    bool open[4] = {
+        below[1] == Material::EMPTY,
+        below[2] == Material::EMPTY,
+        below[3] == Material::EMPTY,
+        below[4] == Material::EMPTY
+    };
+    if (open[0] || open[1] || open[2] || open[3]) {
+        restless = true;
+        restlessBricks[grid.brickIndex(x / Grid::BRICK, y / Grid::BRICK, z / Grid::BRICK)] = 1;
+    }
 
-    if (dir == 0 && grid.get(x + 1, y, z) == Material::EMPTY) {
-        grid.getNextBuffer()[grid.index(x + 1, y, z)] = Material::WATER;
-        grid.getNextBuffer()[grid.index(x, y, z)] = Material::EMPTY;
-    } else if (dir == 1 && grid.get(x - 1, y, z) == Material::EMPTY) {
-        grid.getNextBuffer()[grid.index(x - 1, y, z)] = Material::WATER;
-        grid.getNextBuffer()[grid.index(x, y, z)] = Material::EMPTY;
-    } else if (dir == 2 && grid.get(x, y, z + 1) == Material::EMPTY) {
-        grid.getNextBuffer()[grid.index(x, y, z + 1)] = Material::WATER;
-        grid.getNextBuffer()[grid.index(x, y, z)] = Material::EMPTY;
-    } else if (dir == 3 && grid.get(x, y, z - 1) == Material::EMPTY) {
-        grid.getNextBuffer()[grid.index(x, y, z - 1)] = Material::WATER;
-        grid.getNextBuffer()[grid.index(x, y, z)] = Material::EMPTY;
+    if (dir == 0 && open[0]) {
+        move(grid, Material::SAND, x, y, z, x + 1, y - 1, z);
+    } else if (dir == 1 && open[1]) {
+        move(grid, Material::SAND, x, y, z, x - 1, y - 1, z);
+    } else if (dir == 2 && open[2]) {
+        move(grid, Material::SAND, x, y, z, x, y - 1, z + 1);
+    } else if (dir == 3 && open[3]) {
+        move(grid, Material::SAND, x, y, z, x, y - 1, z - 1);
     }
 }
 
-void Rules::updateGOL(Material m, Grid& grid, int x, int y, int z)
+void Rules::updateFluid(Grid& grid, const std::vector<uint8_t>& active)
 {
-    // Count neighbors
-    int count = 0;
-    for (int dz = -1; dz <= 1; ++dz)
-    for (int dy = -1; dy <= 1; ++dy)
-    for (int dx = -1; dx <= 1; ++dx)
-    {
-        if (dx == 0 && dy == 0 && dz == 0) continue;
+    // Each phase pairs every cell with one neighbour along an axis, alternating
+    // the pairing parity, so the pairs of a phase are disjoint and mass is conserved
+    const int size = grid.getSize();
+    const int depth = grid.getDepth();
+    const int bricks = grid.getBricks();
+    const int axes[6] = {1, 1, 0, 0, 2, 2};
+    const int parities[6] = {0, 1, 0, 1, 0, 1};
+    CellBuffer& cells = grid.getNextBuffer();
+    uint8_t* bytes = cells.isPacked() ? nullptr : cells.data();
+    auto& mass = grid.getMassBuffer();
+    float* heat = tracksHeat ? grid.getFields().next<CellField::TEMPERATURE>().data() : nullptr;
+    std::vector<uint8_t> changed(size);
+    std::vector<uint8_t> unpacked[2] = {std::vector<uint8_t>(bytes ? 0 : size), std::vector<uint8_t>(bytes ? 0 : size)};
+
+    for (int phase = 0; phase < 6; ++phase) {
+        int axis = axes[phase];
+        int parity = parities[phase];
+        int dx = (axis == 0), dy = (axis == 1), dz = (axis == 2);
 
-        int nx = x + dx;
-        int ny = y + dy;
-        int nz = z + dz;
+        // A wrapping axis also pairs its last cell with its first, a slab's z faces are paired by exchangeFluid
+        int extent = (axis == 2) ? depth : size;
+        int pairs = grid.wraps(axis) ? extent : extent - 1;
 
-        if (grid.inBounds(nx, ny, nz) &&
-            grid.get(nx, ny, nz) == Material::GOL)
+        for (int bz = 0; bz < depth / Grid::BRICK; ++bz)
+        for (int by = 0; by < bricks; ++by)
+        for (int bx = 0; bx < bricks; ++bx)
         {
-            count++;
+            // A pair belongs to the brick holding its lower cell, and runs of active bricks along x level together
+            if (!active[grid.brickIndex(bx, by, bz)]) continue;
+            int bxEnd = bx + 1;
+            while (bxEnd < bricks && active[grid.brickIndex(bxEnd, by, bz)]) ++bxEnd;
+
+            for (int z = bz * Grid::BRICK; z < (bz + 1) * Grid::BRICK; ++z) {
+                if (dz && ((z & 1) != parity || z >= pairs)) continue;
+                for (int y = by * Grid::BRICK; y < (by + 1) * Grid::BRICK; ++y) {
+                    if (dy && ((y & 1) != parity || y >= pairs)) continue;
+                    int x0 = bx * Grid::BRICK + (dx ? parity : 0);
+                    int x1 = std::min(bxEnd * Grid::BRICK, dx ? pairs : size);
+                    int ny = (y + dy == size) ? 0 : y + dy;
+                    int nz = (z + dz == depth) ? 0 : z + dz;
+                    // The whole run of pairs levels in one pass. Along x the pairs interleave within the row,
+                    // and the pair wrapping from the last cell to the first goes on its own. Packed cells are
+                    // unpacked a byte each for the pass, and packed back if any of them changed
+                    int wrapped = (dx && x1 == size && ((size - 1 - x0) & 1) == 0) ? size - 1 : -1;
+                    int n = dx ? (std::min(x1, size - 1) - x0 + 1) / 2 : x1 - x0;
+                    if (n > 0) {
+                        int i = grid.index(x0, y, z);
+                        int j = grid.index(x0 + dx, ny, nz);
+                        int span = dx ? 2 * n : n;
+                        uint8_t* cellA = bytes ? &bytes[i] : unpacked[0].data();
+                        uint8_t* cellB = bytes ? &bytes[j] : dx ? cellA + 1 : unpacked[1].data();
+                        if (!bytes) {
+                            cells.unpack(i, i + span, cellA);
+                            if (!dx) cells.unpack(j, j + n, cellB);
+                        }
+                        if (heat) {
+                            flowPairs<true>(cellA, &mass[i], cellB, &mass[j], &heat[i], &heat[j], n, 1 + dx,
+                                            axis == 1, changed.data());
+                        } else {
+                            flowPairs<false>(cellA, &mass[i], cellB, &mass[j], nullptr, nullptr, n, 1 + dx,
+                                             axis == 1, changed.data());
+                        }
+                        bool moved = false;
+                        for (int k = 0; k < n; ++k) {
+                            if (!changed[k]) continue;
+                            int x = x0 + k * (1 + dx);
+                            grid.markDirty(x, y, z);
+                            grid.markDirty(x + dx, ny, nz);
+                            moved = true;
+                        }
+                        if (!bytes && moved) {
+                            cells.pack(i, i + span, cellA);
+                            if (!dx) cells.pack(j, j + n, cellB);
+                        }
+                    }
+                    if (wrapped >= 0) flowPair(grid, wrapped, y, z, 0, ny, nz, false);
+                }
+            }
+            bx = bxEnd - 1;
+        }
+    }
+}
+
+void Rules::drainOpenFaces(Grid& grid, const std::vector<uint8_t>& active)
+{
+    auto& mass = grid.getMassBuffer();
+    auto& cells = grid.getNextBuffer();
+    const int size = grid.getSize();
+    const glm::ivec3 extent(size, size, grid.getDepth());
+
+    for (int axis = 0; axis < 3; ++axis) {
+        if (grid.getBoundary(axis) != Boundary::OPEN) continue;
+        int u = (axis + 1) % 3;
+        int v = (axis + 2) % 3;
+
+        // Water never flows up, so nothing leaves through the top
+        for (int side = 0; side < (axis == 1 ? 1 : 2); ++side) {
+            // A slab only drains through the faces it shares with the whole grid
+            if (axis == 2 && grid.getZOrigin() + (side ? extent.z : 0) != (side ? size : 0)) continue;
+
+            glm::ivec3 c;
+            c[axis] = side ? extent[axis] - 1 : 0;
+            for (c[v] = 0; c[v] < extent[v]; ++c[v]) {
+                for (c[u] = 0; c[u] < extent[u]; ++c[u]) {
+                    if (!active[grid.brickIndex(c.x / Grid::BRICK, c.y / Grid::BRICK, c.z / Grid::BRICK)]) continue;
+                    int i = grid.index(c.x, c.y, c.z);
+                    int a = mass[i];
+                    if (a == 0 || cells[i] != Material::WATER) continue;
+
+                    // Pair the cell with an always-empty one outside, as flowPair would
+                    int na = (axis == 1) ? a - stableBottom(a) : (a > MIN_FLOW ? a - a / 2 : a);
+                    if (na == a) continue;
+                    mass[i] = (uint8_t)na;
+                    cells.set(i, na > 0 ? Material::WATER : Material::EMPTY);
+                    grid.markDirty(c.x, c.y, c.z);
+                }
+            }
         }
     }
+}
+
+void Rules::flowPair(Grid& grid, int x, int y, int z, int nx, int ny, int nz, bool vertical)
+{
+    auto& mass = grid.getMassBuffer();
+    auto& cells = grid.getNextBuffer();
+    int i = grid.index(x, y, z);
+    int j = grid.index(nx, ny, nz);
+    Material a = cells[i];
+    Material b = cells[j];
+    int massA = mass[i];
+    if (!flow(a, mass[i], b, mass[j], vertical)) return;
 
+    cells.set(i, a);
+    cells.set(j, b);
+    if (tracksHeat) {
+        auto& temperature = grid.getFields().next<CellField::TEMPERATURE>();
+        carryHeat(temperature[i], temperature[j], massA - mass[i]);
+    }
+    grid.markDirty(x, y, z);
+    grid.markDirty(nx, ny, nz);
+}
+
+void Rules::updateGOL(Material m, Grid& grid, int x, int y, int z, int count)
+{
     if (m == Material::GOL) {
-        if (count < 5 || count > 7) {
-            grid.getNextBuffer()[grid.index(x, y, z)] = Material::EMPTY;
+        if (!(ruleSet.golSurvive >> count & 1)) {
+            grid.getNextBuffer().set(grid.index(x, y, z), Material::EMPTY);
+            grid.markDirty(x, y, z);
         }
         // else survives (already copied)
     }
     else if (m == Material::EMPTY) {
-        if (count == 6) {
-            grid.getNextBuffer()[grid.index(x, y, z)] = Material::GOL;
+        if (ruleSet.golBirth >> count & 1) {
+            grid.getNextBuffer().set(grid.index(x, y, z), Material::GOL);
+            grid.markDirty(x, y, z);
         }
     }
 
     
 
-}
\ No newline at end of file
+}
+
+void Rules::updateFields(Grid& grid)
+{
+    CellFields& fields = grid.getFields();
+    if (tracksAge) updateAge(grid);
+
+    // Sand that moved may since have been replaced, by a Game of Life birth, with something standing still
+    if (tracksVelocity) {
+        const auto& cells = grid.getNextBuffer();
+        auto& vx = fields.next<CellField::VELOCITY_X>();
+        auto& vy = fields.next<CellField::VELOCITY_Y>();
+        auto& vz = fields.next<CellField::VELOCITY_Z>();
+        for (size_t i = 0; i < cells.size(); ++i) {
+            if ((vx[i] | vy[i] | vz[i]) && cells[i] != Material::SAND) vx[i] = vy[i] = vz[i] = 0;
+        }
+    }
+}
+
+void Rules::updateTemperature(Grid& grid, const std::vector<uint8_t>& active)
+{
+    CellFields& fields = grid.getFields();
+    const auto& heat = fields.current<CellField::TEMPERATURE>();
+    auto& next = fields.next<CellField::TEMPERATURE>();
+    const CellBuffer& cells = grid.getCurrentBuffer();
+    const int size = grid.getSize();
+    const int depth = grid.getDepth();
+    const int bricks = grid.getBricks();
+    const size_t plane = (size_t)size * size;
+
+    // The planes just past the z faces, from the neighbouring slabs or across a periodic face,
+    // and empty where the face is insulated
+    std::vector<float> below, above;
+    if (decomposition) {
+        std::vector<float> bottom(heat.begin(), heat.begin() + plane);
+        std::vector<float> top(heat.end() - plane, heat.end());
+        decomposition->shift(0, bottom, above);
+        decomposition->shift(1, top, below);
+    } else if (grid.wraps(2)) {
+        below.assign(heat.end() - plane, heat.end());
+        above.assign(heat.begin(), heat.begin() + plane);
+    }
+
+    // A cell's flux only differs from last tick's, which left its heat standing, when its own or a neighbour's
+    // heat or material changed since. Those are the bricks next to last tick's conduction changes, or active
+    // from last tick's moves and edits. A slab's end layers can't see the neighbouring slabs' changes, so they
+    // always conduct
+    std::vector<uint8_t> warm(active.size(), 1);
+    if (heatChanged.size() == active.size()) {
+        std::vector<uint8_t> ends;
+        if (decomposition) ends.assign((size_t)bricks * bricks, 1);
+        warm = dilateBricks(grid, heatChanged, ends, ends);
+        for (size_t b = 0; b < warm.size(); ++b) warm[b] |= active[b];
+    }
+    heatChanged.assign(active.size(), 0);
+
+    // Each face passes a share of the difference set by the poorer conductor of its two cells,
+    // so what one cell loses the other gains. Wall and open faces of the whole grid are insulated
+    float conductivity[(int)Material::COUNT];
+    for (int m = 0; m < (int)Material::COUNT; ++m) {
+        conductivity[m] = getMaterialInfo((Material)m).conductivity / 6.0f;
+    }
+    const bool wrapX = grid.wraps(0);
+    const bool wrapY = grid.wraps(1);
+
+    for (int bz = 0; bz < depth / Grid::BRICK; ++bz)
+    for (int by = 0; by < bricks; ++by)
+    for (int bx = 0; bx < bricks; ++bx)
+    {
+        const int b = grid.brickIndex(bx, by, bz);
+        if (!warm[b]) {
+            for (int z = bz * Grid::BRICK; z < (bz + 1) * Grid::BRICK; ++z) {
+                for (int y = by * Grid::BRICK; y < (by + 1) * Grid::BRICK; ++y) {
+                    const int row = grid.index(bx * Grid::BRICK, y, z);
+                    std::copy(heat.begin() + row, heat.begin() + row + Grid::BRICK, next.begin() + row);
+                }
+            }
+            continue;
+        }
+
+        bool changed = false;
+        for (int z = bz * Grid::BRICK; z < (bz + 1) * Grid::BRICK; ++z) {
+            for (int y = by * Grid::BRICK; y < (by + 1) * Grid::BRICK; ++y) {
+                for (int x = bx * Grid::BRICK; x < (bx + 1) * Grid::BRICK; ++x) {
+                    const int i = grid.index(x, y, z);
+                    const float t = heat[i];
+                    const float k = conductivity[(int)cells[i]];
+                    float flux = 0.0f;
+                    auto exchange = [&](Material m, float neighbour) {
+                        flux += std::min(k, conductivity[(int)m]) * (neighbour - t);
+                    };
+
+                    // Neighbours inside the grid are read in place, only those past a face are resolved
+                    if (x > 0) exchange(cells[i - 1], heat[i - 1]);
+                    else if (wrapX) exchange(grid.haloCell(-1, y, z), heat[i + size - 1]);
+                    if (x < size - 1) exchange(cells[i + 1], heat[i + 1]);
+                    else if (wrapX) exchange(grid.haloCell(size, y, z), heat[i - (size - 1)]);
+
+                    if (y > 0) exchange(cells[i - size], heat[i - size]);
+                    else if (wrapY) exchange(grid.haloCell(x, -1, z), heat[i + (size - 1) * size]);
+                    if (y < size - 1) exchange(cells[i + size], heat[i + size]);
+                    else if (wrapY) exchange(grid.haloCell(x, size, z), heat[i - (size - 1) * size]);
+
+                    if (z > 0) exchange(cells[i - plane], heat[i - plane]);
+                    else if (!below.empty()) exchange(grid.haloCell(x, y, -1), below[i]);
+                    if (z < depth - 1) exchange(cells[i + plane], heat[i + plane]);
+                    else if (!above.empty()) exchange(grid.haloCell(x, y, depth), above[i - (depth - 1) * plane]);
+
+                    next[i] = t + flux;
+                    changed = changed || next[i] != t;
+                }
+            }
+        }
+        heatChanged[b] = changed;
+    }
+}
+
+void Rules::updateAge(Grid& grid)
+{
+    // Empty cells have no age, and anything else keeps the age it reached this tick while its cell keeps
+    // the same material, moves having already restarted it where they landed
+    auto& next = grid.getFields().next<CellField::AGE>();
+    const CellBuffer& before = grid.getCurrentBuffer();
+    const CellBuffer& after = grid.getNextBuffer();
+    for (size_t i = 0; i < after.size(); ++i) {
+        Material m = after[i];
+        if (m == Material::EMPTY || m != before[i]) next[i] = 0;
+    }
+}
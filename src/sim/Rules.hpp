@@ -1,17 +1,115 @@
 #pragma once
 
+#include "CycleDetector.hpp"
+#include "Decomposition.hpp"
 #include "Grid.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// \brief Neighbour counts under which Game of Life cells survive or are born
+struct RuleSet
+{
+    uint32_t golSurvive = (1u << 5) | (1u << 6) | (1u << 7);   // Bit n set: survives with n neighbours
+    uint32_t golBirth = 1u << 6;                               // Bit n set: born with n neighbours
+
+    /// \brief Parse survive/birth notation such as "S5-7/B6"
+    /// \param text Rule string, counts separated by commas with optional ranges
+    /// \param out Filled with the parsed rule set on success
+    static bool parse(const std::string& text, RuleSet& out);
+
+    /// \brief Format the rule set in survive/birth notation
+    std::string toString() const;
+};
 
 class Rules
 {
 public:
+    /// \brief Cellular automata rules for one simulation
+    /// \param ruleSet Game of Life survive and birth counts
+    /// \param seed Seed for random sand slides
+    explicit Rules(const RuleSet& ruleSet = RuleSet(), uint32_t seed = 42);
+
     /// \brief Function that updates all materials in the grid according to their respective rules
-    static void update(Grid& grid);
+    /// Once the grid settles into a still life or cycle, the cycle is replayed rather than recomputed,
+    /// unless the grid has per-cell fields, which the replay would leave behind.
+    /// Fields are only updated once allocated, so grids without them pay nothing for them
+    void update(Grid& grid);
+
+    /// \brief Update a slab of a distributed grid, trading halos and migrating material with the neighbouring slabs
+    /// Every slab must be updated in step, and the result matches updating the whole grid in one process.
+    /// Cycle replay is off, since it would need every slab to agree on the cycle
+    /// \param decomposition Slab layout and transport, null to update a whole grid again
+    void setDecomposition(Decomposition* decomposition) { this->decomposition = decomposition; }
+
+    /// \brief Get the length of the cycle the grid has settled into, 1 for a fixed point and 0 if none
+    int getPeriod() const { return cycle.getPeriod(); }
+
+    /// \brief Get the tick the settled cycle started at, -1 if none
+    int64_t getCycleStart() const { return cycle.getCycleStart(); }
 
 private:
-    // Update functions for each material
-    static void updateSand(Grid& grid, int x, int y, int z);
-    static void updateWater(Grid& grid, int x, int y, int z);
-    static void updateEmpty(Grid& grid, int x, int y, int z);
-    static void updateGOL(Material m, Grid& grid, int x, int y, int z);
+    /// Sand leaving a slab, landing at (x, y) of the neighbouring slab's nearest layer
+    struct Crossing
+    {
+        uint16_t x, y;
+        uint8_t overwrites;             // Moved after the target's own update in serial order, so sand wins
+        float temperature;              // Heat the grain carries, when the grid tracks it
+    };
+
+    RuleSet ruleSet;
+    uint32_t seed;                  // Keys random sand slides along with the tick and cell
+    uint64_t tick;
+    CycleDetector cycle;
+    bool restless;                  // Some sand this tick had a random choice of slide
+    Decomposition* decomposition;   // Neighbouring slabs of a distributed run, null for a whole grid
+    std::vector<Crossing> crossing[2];  // Sand leaving through the bottom and top z faces this tick
+    bool tracksVelocity;            // The grid has the velocity fields, so moves record themselves
+    bool tracksHeat;                // The grid has the temperature field, so moves carry heat along
+    bool tracksAge;                 // The grid has the age field, so moves restart it
+    std::vector<int> crossingSource[2]; // Cell each grain in crossing left, in the same order
+    std::vector<int> landedFrom[2];     // First cell whose grain landed in each cell of the bottom and top layers
+                                        // this tick, -1 for none
+    std::vector<uint8_t> heatChanged;   // Bricks whose heat conduction changed last tick
+    std::vector<uint8_t> restlessBricks;    // Bricks holding sand with a slide open this tick, which may take it
+                                            // next tick with nothing around it changing
+
+    // Update sand and Game of Life cells of the active bricks in order, in byte or packed storage
+    void updateCells(Grid& grid, const std::vector<uint8_t>& active);
+    void updatePackedCells(Grid& grid, const std::vector<uint8_t>& active);
+
+    // Update functions for each material, given the cells below a grain (straight down, then the
+    // +x, -x, +z and -z diagonals) or a cell's count of live neighbours
+    void updateSand(Grid& grid, int x, int y, int z, const Material below[5]);
+    void updateFluid(Grid& grid, const std::vector<uint8_t>& active);
+    void updateGOL(Material m, Grid& grid, int x, int y, int z, int count);
+
+    // Update the grid's allocated fields from this tick's material changes
+    void updateFields(Grid& grid);
+    static void updateAge(Grid& grid);
+
+    // Conduct heat between the cells as they stand before anything moves, skipping bricks it settled in
+    void updateTemperature(Grid& grid, const std::vector<uint8_t>& active);
+
+    // Let water out through open faces of the whole grid as if an empty cell lay beyond them
+    static void drainOpenFaces(Grid& grid, const std::vector<uint8_t>& active);
+
+    // Move a material into an empty cell of the next buffer, across periodic faces, out of open ones
+    // or into the neighbouring slab
+    void move(Grid& grid, Material m, int x, int y, int z, int nx, int ny, int nz);
+
+    // Bricks to update this tick, from the slab's own changed flags and its neighbours' nearest layers
+    std::vector<uint8_t> activeBricks(Grid& grid);
+
+    // Trade the slab's end planes with the neighbouring slabs, for the rows past its z faces
+    void exchangeHaloPlanes(Grid& grid);
+
+    // Land the sand that neighbouring slabs moved into this one
+    void deliverSand(Grid& grid);
+
+    // Flow water between this slab's top layer and the bottom layer of the slab above
+    void exchangeFluid(Grid& grid, const std::vector<uint8_t>& active);
+
+    // Exchange water mass between two neighbouring cells in the next buffer, along with its heat
+    void flowPair(Grid& grid, int x, int y, int z, int nx, int ny, int nz, bool vertical);
 };
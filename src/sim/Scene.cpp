@@ -0,0 +1,369 @@
+#include "Scene.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace {
+    constexpr char CACHE_MAGIC[8] = {'A', 'U', 'T', 'O', 'G', 'R', 'I', 'D'};
+    constexpr uint32_t CACHE_VERSION = 1;
+
+    // FNV-1a, continued from a previous hash
+    uint64_t hashBytes(const void* data, size_t length, uint64_t h = 14695981039346656037ull)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < length; ++i) {
+            h = (h ^ bytes[i]) * 1099511628211ull;
+        }
+        return h;
+    }
+
+    bool parseMaterial(const std::string& name, Material& out)
+    {
+        for (int m = 0; m < (int)Material::COUNT; ++m) {
+            if (name == getMaterialName((Material)m)) {
+                out = (Material)m;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool parseBoundary(const std::string& name, Boundary& out)
+    {
+        const char* names[] = {"wall", "periodic", "open"};
+        for (int b = 0; b < 3; ++b) {
+            if (name == names[b]) {
+                out = (Boundary)b;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Velocity turns on all three of its components
+    bool parseFields(const std::string& name, std::vector<CellField>& out)
+    {
+        if (name == "temperature") {
+            out.push_back(CellField::TEMPERATURE);
+        } else if (name == "velocity") {
+            out.insert(out.end(), {CellField::VELOCITY_X, CellField::VELOCITY_Y, CellField::VELOCITY_Z});
+        } else if (name == "age") {
+            out.push_back(CellField::AGE);
+        } else {
+            return false;
+        }
+        return true;
+    }
+}
+
+Scene::Scene() : size(Grid::DEFAULT_SIZE), seed(42),
+                 boundaries{Boundary::WALL, Boundary::WALL, Boundary::WALL}, hash(0) {}
+
+bool Scene::load(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open scene file: " << path << std::endl;
+        return false;
+    }
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // Relative volume paths are resolved against the scene's directory
+    size_t slash = path.find_last_of('/');
+    std::string dir = (slash == std::string::npos) ? "" : path.substr(0, slash + 1);
+
+    size = Grid::DEFAULT_SIZE;
+    seed = 42;
+    ruleSet = RuleSet();
+    boundaries = {Boundary::WALL, Boundary::WALL, Boundary::WALL};
+    primitives.clear();
+    fields.clear();
+    heat.clear();
+    cachePath = path + ".cache";
+    hash = hashBytes(&CACHE_VERSION, sizeof(CACHE_VERSION));
+    hash = hashBytes(text.data(), text.size(), hash);
+
+    std::istringstream lines(text);
+    std::string line;
+    int lineNumber = 0;
+    auto fail = [&](const std::string& message) {
+        std::cerr << "Scene " << path << ":" << lineNumber << ": " << message << std::endl;
+        return false;
+    };
+
+    while (std::getline(lines, line)) {
+        ++lineNumber;
+        line = line.substr(0, line.find('#'));
+        std::istringstream in(line);
+        std::string keyword;
+        if (!(in >> keyword)) continue;
+
+        if (keyword == "size") {
+            if (!(in >> size) || size < Grid::BRICK || size % Grid::BRICK != 0) {
+                return fail("size must be a positive multiple of " + std::to_string(Grid::BRICK));
+            }
+        } else if (keyword == "seed") {
+            if (!(in >> seed)) return fail("expected a seed");
+        } else if (keyword == "rules") {
+            std::string rule;
+            if (!(in >> rule) || !RuleSet::parse(rule, ruleSet)) {
+                return fail("expected rules in S<counts>/B<counts> form");
+            }
+        } else if (keyword == "boundary") {
+            // One mode for every axis, or one each for x, y and z
+            std::string names[3];
+            int count = 0;
+            while (count < 3 && in >> names[count]) ++count;
+            if (count != 1 && count != 3) return fail("expected one boundary, or one each for x y z");
+            for (int axis = 0; axis < 3; ++axis) {
+                if (!parseBoundary(names[count == 1 ? 0 : axis], boundaries[axis])) {
+                    return fail("boundary must be wall, periodic or open");
+                }
+            }
+        } else if (keyword == "field") {
+            std::string name;
+            if (!(in >> name)) return fail("expected a field name");
+            do {
+                if (!parseFields(name, fields)) return fail("field must be temperature, velocity or age");
+            } while (in >> name);
+        } else if (keyword == "heat") {
+            Heat h;
+            if (!(in >> h.lo.x >> h.lo.y >> h.lo.z >> h.hi.x >> h.hi.y >> h.hi.z >> h.degrees)) {
+                return fail("expected: heat x0 y0 z0 x1 y1 z1 degrees");
+            }
+            heat.push_back(h);
+        } else if (keyword == "volume") {
+            Primitive p{Primitive::Type::VOLUME, Material::EMPTY, {}, {}, 0.0f, 0.0f, 0, true, {}};
+            std::string volumePath;
+            glm::ivec3 origin, dims;
+            if (!(in >> volumePath >> origin.x >> origin.y >> origin.z >> dims.x >> dims.y >> dims.z)
+                || dims.x <= 0 || dims.y <= 0 || dims.z <= 0) {
+                return fail("expected: volume <file> x y z width height depth");
+            }
+            if (volumePath[0] != '/') volumePath = dir + volumePath;
+
+            std::ifstream volume(volumePath, std::ios::binary);
+            p.cells.resize((size_t)dims.x * dims.y * dims.z);
+            if (!volume.read(reinterpret_cast<char*>(p.cells.data()), p.cells.size())) {
+                return fail("could not read " + std::to_string(p.cells.size()) + " cells from " + volumePath);
+            }
+            for (Material m : p.cells) {
+                if ((int)m >= (int)Material::COUNT) return fail("invalid material in " + volumePath);
+            }
+            hash = hashBytes(p.cells.data(), p.cells.size(), hash);
+
+            p.a = glm::vec3(origin);
+            p.b = glm::vec3(dims);
+            primitives.push_back(std::move(p));
+        } else {
+            Primitive p{Primitive::Type::BOX, Material::EMPTY, {}, {}, 0.0f, 0.0f, 0, false, {}};
+            std::string material;
+            if (!(in >> material) || !parseMaterial(material, p.material)) {
+                return fail("expected a material after '" + keyword + "'");
+            }
+
+            bool ok;
+            if (keyword == "box") {
+                ok = (bool)(in >> p.a.x >> p.a.y >> p.a.z >> p.b.x >> p.b.y >> p.b.z);
+            } else if (keyword == "sphere") {
+                p.type = Primitive::Type::SPHERE;
+                ok = (bool)(in >> p.a.x >> p.a.y >> p.a.z >> p.radius);
+            } else if (keyword == "line") {
+                p.type = Primitive::Type::LINE;
+                ok = (bool)(in >> p.a.x >> p.a.y >> p.a.z >> p.b.x >> p.b.y >> p.b.z >> p.radius);
+            } else if (keyword == "noise") {
+                p.type = Primitive::Type::NOISE;
+                ok = (bool)(in >> p.a.x >> p.a.y >> p.a.z >> p.b.x >> p.b.y >> p.b.z >> p.probability);
+                p.hasSeed = ok && (bool)(in >> p.seed);
+            } else {
+                return fail("unknown keyword '" + keyword + "'");
+            }
+            if (!ok) return fail("wrong arguments for '" + keyword + "'");
+
+            primitives.push_back(std::move(p));
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<Grid> Scene::createGrid(CellStorage storage) const
+{
+    auto grid = std::make_unique<Grid>(size, boundaries, storage);
+    if (cacheMatches(*grid)) {
+        if (readCache(*grid)) {
+            fillFields(*grid);
+            return grid;
+        }
+        // A failed read may have half-written the grid, so start it over
+        grid = std::make_unique<Grid>(size, boundaries, storage);
+    }
+
+    // Brick-aligned slabs of z never share a brick, so threads can fill them independently
+    int bricks = grid->getBricks();
+    int threads = (int)std::min<unsigned>(std::max(std::thread::hardware_concurrency(), 1u), bricks);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        int z0 = bricks * t / threads * Grid::BRICK;
+        int z1 = bricks * (t + 1) / threads * Grid::BRICK;
+        workers.emplace_back(&Scene::fillSlab, this, std::ref(*grid), z0, z1);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    writeCache(*grid);
+    fillFields(*grid);
+    return grid;
+}
+
+std::unique_ptr<Rules> Scene::createRules() const
+{
+    return std::make_unique<Rules>(ruleSet, seed);
+}
+
+void Scene::fill(Grid& grid) const
+{
+    fillSlab(grid, grid.getZOrigin(), grid.getZOrigin() + grid.getDepth());
+    fillFields(grid);
+}
+
+void Scene::setSeed(uint32_t seed)
+{
+    this->seed = seed;
+    hash = hashBytes(&seed, sizeof(seed), hash);
+}
+
+void Scene::setRuleSet(const RuleSet& ruleSet)
+{
+    this->ruleSet = ruleSet;
+}
+
+void Scene::setDensity(float density)
+{
+    for (Primitive& p : primitives) {
+        if (p.type == Primitive::Type::NOISE) p.probability = density;
+    }
+    hash = hashBytes(&density, sizeof(density), hash);
+}
+
+bool Scene::hasNoise() const
+{
+    return std::any_of(primitives.begin(), primitives.end(),
+                       [](const Primitive& p) { return p.type == Primitive::Type::NOISE; });
+}
+
+void Scene::fillSlab(Grid& grid, int z0, int z1) const
+{
+    const int far = std::numeric_limits<int>::max();
+    glm::ivec3 clipLo(0, 0, z0);
+    glm::ivec3 clipHi(far, far, z1);
+
+    for (size_t i = 0; i < primitives.size(); ++i) {
+        const Primitive& p = primitives[i];
+        switch (p.type) {
+            case Primitive::Type::BOX:
+                grid.fillBox(glm::ivec3(p.a), glm::ivec3(p.b), p.material, clipLo, clipHi);
+                break;
+            case Primitive::Type::SPHERE:
+                grid.fillSphere(p.a, p.radius, p.material, clipLo, clipHi);
+                break;
+            case Primitive::Type::LINE:
+                grid.fillLine(p.a, p.b, p.radius, p.material, clipLo, clipHi);
+                break;
+            case Primitive::Type::NOISE: {
+                // Noise without its own seed derives one from the scene seed, distinct per primitive
+                uint32_t noiseSeed = p.hasSeed ? p.seed : seed + (uint32_t)i * 2654435761u;
+                grid.fillNoise(glm::ivec3(p.a), glm::ivec3(p.b), p.material, p.probability, noiseSeed, clipLo, clipHi);
+                break;
+            }
+            case Primitive::Type::VOLUME:
+                grid.pasteVolume(glm::ivec3(p.a), glm::ivec3(p.b), p.cells, clipLo, clipHi);
+                break;
+        }
+    }
+}
+
+void Scene::fillFields(Grid& grid) const
+{
+    for (CellField f : fields) {
+        grid.getFields().enable(f);
+    }
+    for (const Heat& h : heat) {
+        grid.fillTemperature(h.lo, h.hi, h.degrees);
+    }
+}
+
+bool Scene::cacheMatches(const Grid& grid) const
+{
+    std::ifstream file(cachePath, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) return false;
+
+    // A complete image holds the header, then the cells in the grid's storage and a mass byte per cell,
+    // so an image of the other storage never matches
+    uint64_t expected = sizeof(CACHE_MAGIC) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(int32_t)
+                      + grid.getCurrentBuffer().byteSize() + grid.getMassBuffer().size();
+    if ((uint64_t)file.tellg() != expected) return false;
+    file.seekg(0);
+
+    char magic[sizeof(CACHE_MAGIC)];
+    uint32_t version = 0;
+    uint64_t cachedHash = 0;
+    int32_t cachedSize = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    file.read(reinterpret_cast<char*>(&cachedHash), sizeof(cachedHash));
+    file.read(reinterpret_cast<char*>(&cachedSize), sizeof(cachedSize));
+    return file && std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) == 0 && version == CACHE_VERSION
+        && cachedHash == hash && cachedSize == size;
+}
+
+bool Scene::readCache(Grid& grid) const
+{
+    std::ifstream file(cachePath, std::ios::binary);
+    file.seekg(sizeof(CACHE_MAGIC) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(int32_t));
+
+    auto& cells = grid.getCurrentBuffer();
+    auto& mass = grid.getMassBuffer();
+    file.read(reinterpret_cast<char*>(cells.data()), cells.byteSize());
+    file.read(reinterpret_cast<char*>(mass.data()), mass.size());
+    if (!file) {
+        std::cerr << "Failed to read scene cache: " << cachePath << std::endl;
+        return false;
+    }
+    grid.markAllDirty();
+    return true;
+}
+
+void Scene::writeCache(const Grid& grid) const
+{
+    // Written beside the cache under a name no other writer shares, then renamed over it,
+    // so concurrent runs only ever read a whole cache
+    const std::string tempPath = cachePath + "." + std::to_string(std::random_device()()) + ".tmp";
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write scene cache: " << cachePath << std::endl;
+        return;
+    }
+
+    int32_t cachedSize = grid.getSize();
+    const auto& cells = grid.getCurrentBuffer();
+    const auto& mass = grid.getMassBuffer();
+    file.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    file.write(reinterpret_cast<const char*>(&CACHE_VERSION), sizeof(CACHE_VERSION));
+    file.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+    file.write(reinterpret_cast<const char*>(&cachedSize), sizeof(cachedSize));
+    file.write(reinterpret_cast<const char*>(cells.data()), cells.byteSize());
+    file.write(reinterpret_cast<const char*>(mass.data()), mass.size());
+    file.close();
+    if (!file || std::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+        std::cerr << "Failed to write scene cache: " << cachePath << std::endl;
+        std::remove(tempPath.c_str());
+    }
+}
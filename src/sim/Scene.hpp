@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Grid.hpp"
+#include "Rules.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+class Scene
+{
+public:
+    /// \brief Declarative description of a starting grid and its rules
+    Scene();
+
+    /// \brief Read a scene description file
+    /// \param path Path to the scene file
+    bool load(const std::string& path);
+
+    /// \brief Build the scene's grid, reusing the binary cache when the description is unchanged
+    /// \param storage Byte or packed cells
+    std::unique_ptr<Grid> createGrid(CellStorage storage = CellStorage::BYTE) const;
+
+    /// \brief Create rules seeded from the scene
+    std::unique_ptr<Rules> createRules() const;
+
+    /// \brief Apply the scene to a grid on the calling thread, bypassing the cache
+    /// \param grid Grid of the scene's size and boundaries, as freshly constructed, or a slab of one
+    void fill(Grid& grid) const;
+
+    /// \brief Override the scene seed, which also reseeds noise without its own seed
+    void setSeed(uint32_t seed);
+
+    /// \brief Override the Game of Life rule set
+    void setRuleSet(const RuleSet& ruleSet);
+
+    /// \brief Override the fill probability of every noise primitive
+    void setDensity(float density);
+
+    /// \brief Check if the scene has a noise primitive for setDensity to act on
+    bool hasNoise() const;
+
+    /// \brief Get the grid edge length in cells
+    int getSize() const { return size; }
+
+    /// \brief Get the boundary of each axis
+    const Boundaries& getBoundaries() const { return boundaries; }
+
+    /// \brief Get the scene seed
+    uint32_t getSeed() const { return seed; }
+
+    /// \brief Get the Game of Life rule set
+    const RuleSet& getRuleSet() const { return ruleSet; }
+
+private:
+    /// One fill applied to the grid, in file order
+    struct Primitive
+    {
+        enum class Type { BOX, SPHERE, LINE, NOISE, VOLUME } type;
+        Material material;
+        glm::vec3 a;                    // Box/noise lower corner, sphere centre, line start, volume origin
+        glm::vec3 b;                    // Box/noise upper corner, line end, volume dimensions
+        float radius;
+        float probability;
+        uint32_t seed;
+        bool hasSeed;                   // Noise seed given in the file rather than derived
+        std::vector<Material> cells;    // Imported volume contents
+    };
+
+    /// Temperature set over a box once the cells are filled
+    struct Heat
+    {
+        glm::ivec3 lo, hi;
+        float degrees;
+    };
+
+    int size;
+    uint32_t seed;
+    RuleSet ruleSet;
+    Boundaries boundaries;
+    std::vector<Primitive> primitives;
+    std::vector<CellField> fields;      // Per-cell fields the scene turns on
+    std::vector<Heat> heat;
+    std::string cachePath;
+    uint64_t hash;                      // Fingerprint of the description and imported volumes
+
+    // Apply every primitive to the cells of a slab of z values
+    void fillSlab(Grid& grid, int z0, int z1) const;
+
+    // Allocate the scene's fields and set their starting values, which the cache does not hold
+    void fillFields(Grid& grid) const;
+
+    // Binary image of a built grid, keyed by the description hash
+    bool cacheMatches(const Grid& grid) const;
+    bool readCache(Grid& grid) const;
+    void writeCache(const Grid& grid) const;
+};
@@ -0,0 +1,94 @@
+#include "StatsRecorder.hpp"
+#include <iostream>
+
+StatsRecorder::StatsRecorder() : closing(false), failed(false) {}
+
+StatsRecorder::~StatsRecorder()
+{
+    finish();
+}
+
+bool StatsRecorder::open(const std::string& path, const Grid& grid, int threads)
+{
+    file.open(path, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write statistics: " << path << std::endl;
+        return false;
+    }
+    file << "tick,sand,water,life,clusters,largest_cluster,mean_cluster,"
+            "sand_columns,sand_mean_height,sand_max_height,sand_roughness,water_surface\n";
+
+    analytics = std::make_unique<Analytics>(grid, threads);
+    analyser = std::thread(&StatsRecorder::analyserLoop, this);
+    return true;
+}
+
+void StatsRecorder::record(const Grid& grid, uint64_t tick)
+{
+    if (!analyser.joinable()) return;
+
+    // Copying the cells is all the simulation thread pays, into a spare snapshot's storage when there is one
+    Snapshot snapshot{tick, grid.getRevision(), CellBuffer(), {}};
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (!spare.empty()) {
+            snapshot = std::move(spare.back());
+            spare.pop_back();
+            snapshot.tick = tick;
+            snapshot.revision = grid.getRevision();
+        }
+    }
+    snapshot.cells = grid.getCurrentBuffer();
+    snapshot.brickRevisions = grid.getBrickRevisions();
+
+    // Only an analyser far behind holds up the simulation, which bounds the memory queued ticks take
+    std::unique_lock<std::mutex> lock(queueMutex);
+    queueChanged.wait(lock, [this] { return (int)queue.size() < MAX_QUEUED; });
+    queue.push_back(std::move(snapshot));
+    lock.unlock();
+    queueChanged.notify_all();
+}
+
+bool StatsRecorder::finish()
+{
+    if (analyser.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            closing = true;
+        }
+        queueChanged.notify_all();
+        analyser.join();
+    }
+    if (file.is_open()) {
+        file.close();
+        if (file.fail()) failed = true;
+    }
+    return !failed;
+}
+
+void StatsRecorder::analyserLoop()
+{
+    TickStats stats{};
+    while (true) {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        queueChanged.wait(lock, [this] { return closing || !queue.empty(); });
+        if (queue.empty()) return;
+        Snapshot snapshot = std::move(queue.front());
+        queue.pop_front();
+        lock.unlock();
+        queueChanged.notify_all();
+
+        // Ticks arrive in order, so the counters only refresh the bricks changed since the last one
+        analytics->update(snapshot.cells, snapshot.brickRevisions, snapshot.revision);
+        analytics->measure(snapshot.cells, stats);
+        file << snapshot.tick << ',' << stats.population[(int)Material::SAND] << ','
+             << stats.population[(int)Material::WATER] << ',' << stats.population[(int)Material::GOL] << ','
+             << stats.clusters << ',' << stats.largestCluster << ',' << stats.meanCluster << ','
+             << stats.sandColumns << ',' << stats.sandMeanHeight << ',' << stats.sandMaxHeight << ','
+             << stats.sandRoughness << ',' << stats.waterSurface << '\n';
+        if (!file) failed = true;
+
+        lock.lock();
+        spare.push_back(std::move(snapshot));
+    }
+}
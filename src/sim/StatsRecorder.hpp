@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Analytics.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class StatsRecorder
+{
+public:
+    static constexpr int MAX_QUEUED = 8;        // Ticks waiting for the analyser before recording blocks
+
+    /// \brief Measures ticks on a background thread and streams one CSV row per tick to a file
+    StatsRecorder();
+    ~StatsRecorder();
+
+    /// \brief Create the file, write its header and start the analyser
+    /// \param path CSV file to write
+    /// \param grid Grid to record, which must keep its size and boundaries
+    /// \param threads Threads to label clusters with, zero for one per core
+    bool open(const std::string& path, const Grid& grid, int threads = 0);
+
+    /// \brief Queue a copy of the grid's cells for measuring, blocking only when the analyser is far behind
+    /// \param grid Grid given to open
+    /// \param tick Tick the cells are as of
+    void record(const Grid& grid, uint64_t tick);
+
+    /// \brief Measure every queued tick and close the file
+    /// \return False if any row failed to write
+    bool finish();
+
+private:
+    struct Snapshot
+    {
+        uint64_t tick;
+        uint64_t revision;
+        CellBuffer cells;
+        std::vector<uint64_t> brickRevisions;
+    };
+
+    std::unique_ptr<Analytics> analytics;
+    std::ofstream file;
+
+    std::thread analyser;
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    std::deque<Snapshot> queue;
+    std::vector<Snapshot> spare;                // Measured snapshots, reused so recording rarely allocates
+    bool closing;
+    bool failed;
+
+    // Measure queued snapshots until closed
+    void analyserLoop();
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// \brief Point-to-point messaging between the processes of a distributed run
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+
+    /// \brief Get this process's rank, from 0 to getSize() - 1
+    virtual int getRank() const = 0;
+
+    /// \brief Get the number of processes
+    virtual int getSize() const = 0;
+
+    /// \brief Send one message and receive one, progressing both together so neither side blocks the other
+    /// \param to Rank to send to, -1 to send nothing
+    /// \param data Message to send
+    /// \param bytes Message length
+    /// \param from Rank to receive from, -1 to receive nothing
+    /// \param in Filled with the received message, cleared when from is -1
+    virtual bool exchange(int to, const void* data, size_t bytes, int from, std::vector<uint8_t>& in) = 0;
+};
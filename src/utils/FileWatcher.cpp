@@ -0,0 +1,93 @@
+#include "FileWatcher.hpp"
+#include <chrono>
+#include <iostream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr int POLL_MS = 200;    // How long a stop request may wait
+}
+
+FileWatcher::FileWatcher(const std::string& directory) : directory(directory), stopping(false)
+{
+    thread = std::thread(&FileWatcher::watchLoop, this);
+}
+
+FileWatcher::~FileWatcher()
+{
+    stopping = true;
+    if (thread.joinable()) thread.join();
+}
+
+std::vector<std::string> FileWatcher::takeChanged()
+{
+    std::lock_guard<std::mutex> lock(changedMutex);
+    std::vector<std::string> files(changed.begin(), changed.end());
+    changed.clear();
+    return files;
+}
+
+void FileWatcher::markChanged(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(changedMutex);
+    changed.insert(directory + "/" + name);
+}
+
+void FileWatcher::watchLoop()
+{
+#ifdef __linux__
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    // Saves land as a closed write, or as a rename over the old file
+    if (fd >= 0 && inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) >= 0) {
+        alignas(inotify_event) char buffer[4096];
+        pollfd request{fd, POLLIN, 0};
+        while (!stopping) {
+            if (poll(&request, 1, POLL_MS) <= 0) continue;
+
+            ssize_t length;
+            while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+                for (char* p = buffer; p < buffer + length;) {
+                    const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+                    if (event->len > 0) markChanged(event->name);
+                    p += sizeof(inotify_event) + event->len;
+                }
+            }
+        }
+        close(fd);
+        return;
+    }
+    if (fd >= 0) close(fd);
+    std::cerr << "Failed to watch " << directory << " with inotify, polling instead" << std::endl;
+#endif
+    pollLoop();
+}
+
+void FileWatcher::pollLoop()
+{
+    auto known = scan();
+    while (!stopping) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS));
+        auto current = scan();
+        for (const auto& [name, time] : current) {
+            auto it = known.find(name);
+            if (it == known.end() || it->second != time) markChanged(name);
+        }
+        known = std::move(current);
+    }
+}
+
+std::map<std::string, std::filesystem::file_time_type> FileWatcher::scan() const
+{
+    std::map<std::string, std::filesystem::file_time_type> times;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        if (entry.is_regular_file(error)) {
+            times[entry.path().filename().string()] = entry.last_write_time(error);
+        }
+    }
+    return times;
+}
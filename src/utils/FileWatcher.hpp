@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+class FileWatcher
+{
+public:
+    /// \brief Watches a directory on a background thread, with inotify on Linux and by polling elsewhere
+    /// \param directory Directory whose files to watch, not recursively
+    explicit FileWatcher(const std::string& directory);
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    /// \brief Take the files written since the last call, as paths under the watched directory
+    std::vector<std::string> takeChanged();
+
+private:
+    std::string directory;
+    std::thread thread;
+    std::atomic<bool> stopping;
+
+    std::mutex changedMutex;
+    std::set<std::string> changed;      // Editors often write a file several times per save
+
+    // Wait for changes until stopped
+    void watchLoop();
+
+    // Record a changed file by name
+    void markChanged(const std::string& name);
+
+    // Fallback without inotify: compare modification times every poll
+    void pollLoop();
+    std::map<std::string, std::filesystem::file_time_type> scan() const;
+};
@@ -0,0 +1,102 @@
+#include "ImageWriter.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace {
+    uint32_t crc32(const uint8_t* data, size_t length, uint32_t crc = 0)
+    {
+        static const std::vector<uint32_t> table = [] {
+            std::vector<uint32_t> t(256);
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                t[n] = c;
+            }
+            return t;
+        }();
+        crc = ~crc;
+        for (size_t i = 0; i < length; ++i) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    void putBigEndian(std::vector<uint8_t>& out, uint32_t value)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8) out.push_back((uint8_t)(value >> shift));
+    }
+
+    void writeChunk(std::ofstream& file, const char type[4], const std::vector<uint8_t>& data)
+    {
+        std::vector<uint8_t> chunk;
+        putBigEndian(chunk, (uint32_t)data.size());
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        putBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+        file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+    }
+}
+
+bool writePng(const std::string& path, int width, int height, const uint8_t* rgb)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write image: " << path << std::endl;
+        return false;
+    }
+
+    // Scanlines with filter type 0, which the stored deflate blocks below hold verbatim
+    size_t stride = (size_t)width * 3;
+    std::vector<uint8_t> raw;
+    raw.reserve((stride + 1) * height);
+    for (int y = 0; y < height; ++y) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb + y * stride, rgb + (y + 1) * stride);
+    }
+
+    // Uncompressed zlib stream: frames are written faster than any compressor would run
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    uint32_t a = 1, b = 0;
+    size_t pos = 0;
+    while (true) {
+        size_t length = std::min<size_t>(raw.size() - pos, 65535);
+        bool last = pos + length == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back((uint8_t)length);
+        zlib.push_back((uint8_t)(length >> 8));
+        zlib.push_back((uint8_t)~length);
+        zlib.push_back((uint8_t)(~length >> 8));
+        zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + length);
+        for (size_t i = pos; i < pos + length; ++i) {
+            a = (a + raw[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        pos += length;
+        if (last) break;
+    }
+    putBigEndian(zlib, (b << 16) | a);
+
+    std::vector<uint8_t> header;
+    putBigEndian(header, (uint32_t)width);
+    putBigEndian(header, (uint32_t)height);
+    header.insert(header.end(), {8, 2, 0, 0, 0});   // 8-bit RGB, no interlace
+
+    const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+    writeChunk(file, "IHDR", header);
+    writeChunk(file, "IDAT", zlib);
+    writeChunk(file, "IEND", {});
+    return (bool)file;
+}
+
+bool writePpm(const std::string& path, int width, int height, const uint8_t* rgb)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write image: " << path << std::endl;
+        return false;
+    }
+    file << "P6\n" << width << " " << height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(rgb), (size_t)width * height * 3);
+    return (bool)file;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/// \brief Write an RGB image as an uncompressed PNG, rows top to bottom
+/// \param path Output file
+/// \param width Image width
+/// \param height Image height
+/// \param rgb Three bytes per pixel
+bool writePng(const std::string& path, int width, int height, const uint8_t* rgb);
+
+/// \brief Write an RGB image as a binary PPM, rows top to bottom
+/// \param path Output file
+/// \param width Image width
+/// \param height Image height
+/// \param rgb Three bytes per pixel
+bool writePpm(const std::string& path, int width, int height, const uint8_t* rgb);
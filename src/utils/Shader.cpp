@@ -1,10 +1,46 @@
 #include "Shader.hpp"
 #include <glad/glad.h>
 #include <fstream>
+#include <iterator>
 #include <sstream>
 #include <iostream>
+#include <vector>
 #include <glm/gtc/type_ptr.hpp>
 
+namespace {
+    constexpr char BINARY_MAGIC[8] = {'A', 'U', 'T', 'O', 'P', 'R', 'O', 'G'};
+
+    // FNV-1a over a string and its terminator, continued from a previous hash
+    uint64_t hashString(const char* text, uint64_t h = 14695981039346656037ull)
+    {
+        do {
+            h = (h ^ (uint8_t)*text) * 1099511628211ull;
+        } while (*text++);
+        return h;
+    }
+
+    // A binary is only valid for the driver that produced it
+    uint64_t hashDriver(uint64_t h)
+    {
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+            const char* value = reinterpret_cast<const char*>(glGetString(name));
+            h = hashString(value ? value : "", h);
+        }
+        return h;
+    }
+
+    bool binariesSupported()
+    {
+#ifdef GL_NUM_PROGRAM_BINARY_FORMATS
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+#else
+        return false;
+#endif
+    }
+}
+
 Shader::Shader() : program(0) {}
 
 Shader::~Shader()
@@ -45,35 +81,150 @@ unsigned int Shader::compileShader(const std::string& source, unsigned int type)
 }
 
 bool Shader::compile(const std::string& vertPath, const std::string& fragPath)
+{
+    this->vertPath = vertPath;
+    this->fragPath = fragPath;
+
+    unsigned int built = build();
+    if (!built) {
+        return false;
+    }
+
+    replaceProgram(built);
+    return true;
+}
+
+bool Shader::reload()
+{
+    unsigned int built = build();
+    if (!built) {
+        std::cerr << "Keeping the previous program for " << vertPath << " + " << fragPath << std::endl;
+        return false;
+    }
+
+    // The old program is only dropped once its replacement has linked
+    replaceProgram(built);
+    std::cout << "Reloaded " << vertPath << " + " << fragPath << std::endl;
+    return true;
+}
+
+void Shader::replaceProgram(unsigned int built)
+{
+    if (program) {
+        glDeleteProgram(program);
+    }
+    program = built;
+
+    // Locations and block indices belong to the program they were queried from
+    uniforms.clear();
+    for (const auto& [block, binding] : blockBindings) {
+        unsigned int index = glGetUniformBlockIndex(program, block.c_str());
+        if (index != GL_INVALID_INDEX) glUniformBlockBinding(program, index, binding);
+    }
+}
+
+unsigned int Shader::build()
 {
     std::string vertSrc = readFile(vertPath);
     std::string fragSrc = readFile(fragPath);
 
     if (vertSrc.empty() || fragSrc.empty()) {
-        return false;
+        return 0;
+    }
+
+    uint64_t key = hashDriver(hashString(fragSrc.c_str(), hashString(vertSrc.c_str())));
+    if (unsigned int cached = loadBinary(key)) {
+        return cached;
     }
 
     unsigned int vert = compileShader(vertSrc, GL_VERTEX_SHADER);
     unsigned int frag = compileShader(fragSrc, GL_FRAGMENT_SHADER);
 
-    program = glCreateProgram();
-    glAttachShader(program, vert);
-    glAttachShader(program, frag);
-    glLinkProgram(program);
+    unsigned int built = glCreateProgram();
+    glAttachShader(built, vert);
+    glAttachShader(built, frag);
+#ifdef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    glProgramParameteri(built, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+    glLinkProgram(built);
+    glDeleteShader(vert);
+    glDeleteShader(frag);
 
     int success;
     char infoLog[512];
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    glGetProgramiv(built, GL_LINK_STATUS, &success);
     if (!success) {
-        glGetProgramInfoLog(program, 512, nullptr, infoLog);
+        glGetProgramInfoLog(built, 512, nullptr, infoLog);
         std::cerr << "Program linking failed: " << infoLog << std::endl;
-        return false;
+        glDeleteProgram(built);
+        return 0;
     }
 
-    glDeleteShader(vert);
-    glDeleteShader(frag);
+    saveBinary(built, key);
+    return built;
+}
 
-    return true;
+std::string Shader::cachePath() const
+{
+    return fragPath.substr(0, fragPath.find_last_of('.')) + ".program";
+}
+
+unsigned int Shader::loadBinary(uint64_t key) const
+{
+#ifdef GL_NUM_PROGRAM_BINARY_FORMATS
+    if (!binariesSupported()) return 0;
+
+    std::ifstream file(cachePath(), std::ios::binary);
+    if (!file.is_open()) return 0;
+
+    char magic[sizeof(BINARY_MAGIC)];
+    uint64_t cachedKey = 0;
+    uint32_t format = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&cachedKey), sizeof(cachedKey));
+    file.read(reinterpret_cast<char*>(&format), sizeof(format));
+    if (!file || std::string(magic, sizeof(magic)) != std::string(BINARY_MAGIC, sizeof(BINARY_MAGIC))
+        || cachedKey != key) {
+        return 0;
+    }
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // A driver may still reject its own binary, in which case the sources are compiled as usual
+    unsigned int cached = glCreateProgram();
+    glProgramBinary(cached, format, binary.data(), (GLsizei)binary.size());
+    int success;
+    glGetProgramiv(cached, GL_LINK_STATUS, &success);
+    if (!success) {
+        glDeleteProgram(cached);
+        return 0;
+    }
+    return cached;
+#else
+    return 0;
+#endif
+}
+
+void Shader::saveBinary(unsigned int program, uint64_t key) const
+{
+#ifdef GL_NUM_PROGRAM_BINARY_FORMATS
+    if (!binariesSupported()) return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+    std::ofstream file(cachePath(), std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return;
+    uint32_t storedFormat = format;
+    file.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+    file.write(reinterpret_cast<const char*>(&storedFormat), sizeof(storedFormat));
+    file.write(binary.data(), binary.size());
+#endif
 }
 
 void Shader::use() const
@@ -81,19 +232,37 @@ void Shader::use() const
     glUseProgram(program);
 }
 
-void Shader::setMat4(const std::string& name, const glm::mat4& mat) const
+int Shader::getUniform(const std::string& name) const
+{
+    auto it = uniforms.find(name);
+    if (it == uniforms.end()) {
+        it = uniforms.emplace(name, glGetUniformLocation(program, name.c_str())).first;
+    }
+    return it->second;
+}
+
+void Shader::bindBlock(const std::string& block, unsigned int binding)
+{
+    blockBindings.emplace_back(block, binding);
+    unsigned int index = glGetUniformBlockIndex(program, block.c_str());
+    if (index == GL_INVALID_INDEX) {
+        std::cerr << "No uniform block " << block << " in " << vertPath << " + " << fragPath << std::endl;
+        return;
+    }
+    glUniformBlockBinding(program, index, binding);
+}
+
+void Shader::setMat4(int location, const glm::mat4& mat) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(program, name.c_str()), 1, GL_FALSE,
-                       glm::value_ptr(mat));
+    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(mat));
 }
 
-void Shader::setVec3(const std::string& name, const glm::vec3& vec) const
+void Shader::setVec3(int location, const glm::vec3& vec) const
 {
-    glUniform3fv(glGetUniformLocation(program, name.c_str()), 1,
-                 glm::value_ptr(vec));
+    glUniform3fv(location, 1, glm::value_ptr(vec));
 }
 
-void Shader::setInt(const std::string& name, int value) const
+void Shader::setInt(int location, int value) const
 {
-    glUniform1i(glGetUniformLocation(program, name.c_str()), value);
+    glUniform1i(location, value);
 }
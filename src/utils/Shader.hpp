@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <glm/glm.hpp>
 
 class Shader
@@ -11,35 +15,73 @@ public:
     ~Shader();
 
     /// \brief Compile the Shader object given a vertex and fragment shader
+    /// Reuses the program binary cached beside the shaders when their sources and the driver are unchanged
     /// \param vertPath Path to the vertex shader
     /// \param fragPath Path to the fragment shader
     bool compile(const std::string& vertPath, const std::string& fragPath);
 
+    /// \brief Rebuild the program from its source files, keeping the old program if the new one fails
+    /// \return True if the program was replaced
+    bool reload();
+
+    /// \brief Check if the program is built from a given file
+    /// \param path Path as passed to compile
+    bool usesFile(const std::string& path) const { return path == vertPath || path == fragPath; }
+
     /// \brief Activate shader
     void use() const;
 
+    /// \brief Look up a uniform's location, resolved once per program and cached
+    /// \param name Name of the uniform
+    /// \return Location to pass to the setters, -1 if the program has no such uniform
+    int getUniform(const std::string& name) const;
+
+    /// \brief Attach a uniform block to a buffer binding point, reapplied whenever the program is rebuilt
+    /// \param block Name of the uniform block
+    /// \param binding Binding point its buffer is bound to
+    void bindBlock(const std::string& block, unsigned int binding);
+
     /// \brief Utility function for setting a Mat4 object
-    /// \param name Name of the Mat4 object
+    /// \param location Location from getUniform
     /// \param mat Value to set it to
-    void setMat4(const std::string& name, const glm::mat4& mat) const;
+    void setMat4(int location, const glm::mat4& mat) const;
+    void setMat4(const std::string& name, const glm::mat4& mat) const { setMat4(getUniform(name), mat); }
 
     /// \brief Utility function for setting a Vec3 object
-    /// \param name Name of the Vec3 object
+    /// \param location Location from getUniform
     /// \param vec Value to set it to
-    void setVec3(const std::string& name, const glm::vec3& vec) const;
+    void setVec3(int location, const glm::vec3& vec) const;
+    void setVec3(const std::string& name, const glm::vec3& vec) const { setVec3(getUniform(name), vec); }
 
     /// \brief Utility function for setting an Int object
-    /// \param name Name of the Int object
+    /// \param location Location from getUniform
     /// \param value Value to set it to
-    void setInt(const std::string& name, int value) const;
+    void setInt(int location, int value) const;
+    void setInt(const std::string& name, int value) const { setInt(getUniform(name), value); }
 
     /// \brief Get the Shader program
     unsigned int getProgram() const { return program; }
 
 private:
     unsigned int program;   // Shader program
+    std::string vertPath;
+    std::string fragPath;
+
+    mutable std::unordered_map<std::string, int> uniforms;              // Locations looked up so far
+    std::vector<std::pair<std::string, unsigned int>> blockBindings;    // Block name and binding point
+
+    // Make a freshly built program current, applying the block bindings
+    void replaceProgram(unsigned int built);
 
     // Helper functions for reading files and shader compilation
     std::string readFile(const std::string& path);
     unsigned int compileShader(const std::string& source, unsigned int type);
+
+    // Build a program from the source files, zero on failure
+    unsigned int build();
+
+    // Program binary cache, keyed by the sources and the driver that compiled them
+    std::string cachePath() const;
+    unsigned int loadBinary(uint64_t key) const;
+    void saveBinary(unsigned int program, uint64_t key) const;
 };
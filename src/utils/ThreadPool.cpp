@@ -0,0 +1,96 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threads) : nextQueue(0), queued(0), unfinished(0), stopping(false)
+{
+    if (threads <= 0) threads = (int)std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (int i = 0; i < threads; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    taskReady.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    // Count the task before it becomes visible, so a fast worker can't finish it first
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        ++unfinished;
+    }
+
+    Queue& queue = *queues[nextQueue++ % queues.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        ++queued;
+    }
+    taskReady.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(stateMutex);
+    allDone.wait(lock, [this] { return unfinished == 0; });
+}
+
+void ThreadPool::workerLoop(int id)
+{
+    std::function<void()> task;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(stateMutex);
+            taskReady.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping && queued == 0) return;
+        }
+
+        // Another worker may win the race for the last task, so this can come up empty
+        if (!takeTask(id, task)) continue;
+        task();
+        task = nullptr;
+
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (--unfinished == 0) allDone.notify_all();
+    }
+}
+
+bool ThreadPool::takeTask(int id, std::function<void()>& task)
+{
+    int n = (int)queues.size();
+    for (int i = 0; i < n; ++i) {
+        Queue& queue = *queues[(id + i) % n];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+
+        // Own queue runs newest first, thieves take the oldest from the other end
+        if (i == 0) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+
+        std::lock_guard<std::mutex> stateLock(stateMutex);
+        --queued;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    /// \brief Fixed set of worker threads, each with its own task queue that idle workers steal from
+    /// \param threads Number of workers, zero for one per core
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// \brief Queue a task, spreading tasks over the workers' queues in turn
+    /// \param task Task to run on some worker
+    void submit(std::function<void()> task);
+
+    /// \brief Block until every submitted task has finished
+    void wait();
+
+    /// \brief Get the number of workers
+    int getThreadCount() const { return (int)workers.size(); }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;     // One per worker
+    std::vector<std::thread> workers;
+    std::atomic<unsigned> nextQueue;                // Round-robin submit target
+
+    std::mutex stateMutex;
+    std::condition_variable taskReady;
+    std::condition_variable allDone;
+    int queued;                                     // Tasks waiting in any queue
+    int unfinished;                                 // Tasks submitted but not yet finished
+    bool stopping;
+
+    // Run tasks until the pool is destroyed
+    void workerLoop(int id);
+
+    // Pop from the worker's own queue, or steal the oldest task of another
+    bool takeTask(int id, std::function<void()>& task);
+};
@@ -0,0 +1,26 @@
+#include "UniformBuffer.hpp"
+#include <glad/glad.h>
+
+UniformBuffer::UniformBuffer() : buffer(0), size(0) {}
+
+UniformBuffer::~UniformBuffer()
+{
+    if (buffer) glDeleteBuffers(1, &buffer);
+}
+
+void UniformBuffer::create(size_t size, unsigned int binding)
+{
+    this->size = size;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, (GLsizeiptr)size, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+}
+
+void UniformBuffer::update(const void* data) const
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, (GLsizeiptr)size, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
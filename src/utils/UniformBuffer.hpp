@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+class UniformBuffer
+{
+public:
+    /// \brief An OpenGL uniform buffer bound to a fixed binding point, shared by every program using its block
+    UniformBuffer();
+    ~UniformBuffer();
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    /// \brief Allocate the buffer and bind it
+    /// \param size Size of the block in bytes, laid out std140
+    /// \param binding Binding point programs attach the block to with Shader::bindBlock
+    void create(size_t size, unsigned int binding);
+
+    /// \brief Replace the buffer's contents
+    /// \param data Block contents, the size given to create
+    void update(const void* data) const;
+
+private:
+    unsigned int buffer;
+    size_t size;
+};
@@ -0,0 +1,280 @@
+#include "ReferenceRules.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+// Restated from the rules rather than shared with them, so a mistake in one shows up against the other
+namespace {
+    constexpr int COMPRESS = 2;     // Extra mass a cell holds per full cell stacked above it
+    constexpr int MIN_FLOW = 4;     // Smallest lateral mass difference worth equalizing
+
+    // Mass the lower of two stacked cells holds once settled, given their combined mass
+    int stableBottom(int total)
+    {
+        const int full = Grid::FULL_MASS;
+        if (total <= full) return total;
+        if (total < 2 * full + COMPRESS) return (full * full + total * COMPRESS) / (full + COMPRESS);
+        return std::min((total + COMPRESS) / 2, (int)Grid::MAX_MASS);
+    }
+
+    // One of four sand slides, hashed from the seed, tick and cell
+    int slideDirection(uint32_t seed, uint64_t tick, int x, int y, int z)
+    {
+        uint64_t h = ((uint64_t)seed << 32) ^ tick;
+        h ^= ((uint64_t)(uint32_t)x * 73856093u) ^ ((uint64_t)(uint32_t)y * 19349663u << 16)
+           ^ ((uint64_t)(uint32_t)z * 83492791u << 32);
+        h ^= h >> 33; h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return (int)(h & 3);
+    }
+
+    // Bring a position up to one cell outside the grid back across periodic faces, false past a closed one
+    bool wrapInside(const Grid& grid, glm::ivec3& c)
+    {
+        const int size = grid.getSize();
+        for (int axis = 0; axis < 3; ++axis) {
+            if (c[axis] >= 0 && c[axis] < size) continue;
+            if (grid.getBoundary(axis) != Boundary::PERIODIC) return false;
+            c[axis] = (c[axis] + size) % size;
+        }
+        return true;
+    }
+
+    Material get(const Grid& grid, const glm::ivec3& c)
+    {
+        return grid.get(c.x, c.y, c.z);
+    }
+
+    int index(const Grid& grid, const glm::ivec3& c)
+    {
+        return grid.index(c.x, c.y, c.z);
+    }
+}
+
+ReferenceRules::ReferenceRules(const RuleSet& ruleSet, uint32_t seed) : ruleSet(ruleSet), seed(seed), tick(0) {}
+
+void ReferenceRules::update(Grid& grid)
+{
+    ++tick;
+    CellFields& fields = grid.getFields();
+    grid.getNextBuffer() = grid.getCurrentBuffer();
+
+    // Velocity holds only this tick's moves, and everything ages a tick unless it moves or changes
+    if (fields.has(CellField::VELOCITY_X)) {
+        auto& vx = fields.next<CellField::VELOCITY_X>();
+        auto& vy = fields.next<CellField::VELOCITY_Y>();
+        auto& vz = fields.next<CellField::VELOCITY_Z>();
+        for (size_t i = 0; i < vx.size(); ++i) vx[i] = vy[i] = vz[i] = 0;
+    }
+    if (fields.has(CellField::AGE)) {
+        const auto& age = fields.current<CellField::AGE>();
+        auto& next = fields.next<CellField::AGE>();
+        for (size_t i = 0; i < age.size(); ++i) next[i] = (uint16_t)std::min(age[i] + 1, 0xFFFF);
+    }
+
+    // Heat conducts before anything moves, then moves carry it along
+    if (fields.has(CellField::TEMPERATURE)) conduct(grid);
+    updateCells(grid);
+    flow(grid);
+    drain(grid);
+    settleFields(grid);
+    grid.swapBuffers();
+}
+
+void ReferenceRules::conduct(Grid& grid)
+{
+    CellFields& fields = grid.getFields();
+    const auto& heat = fields.current<CellField::TEMPERATURE>();
+    auto& next = fields.next<CellField::TEMPERATURE>();
+    const int size = grid.getSize();
+    const glm::ivec3 faces[6] = {{-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
+
+    // Each face passes a share of the difference set by the poorer conductor, and closed faces none
+    auto conductivity = [](Material m) { return getMaterialInfo(m).conductivity / 6.0f; };
+    for (int z = 0; z < size; ++z)
+    for (int y = 0; y < size; ++y)
+    for (int x = 0; x < size; ++x)
+    {
+        const glm::ivec3 c(x, y, z);
+        const float t = heat[index(grid, c)];
+        const float k = conductivity(get(grid, c));
+        float flux = 0.0f;
+        for (const glm::ivec3& face : faces) {
+            glm::ivec3 n = c + face;
+            const Material m = get(grid, n);
+            if (!wrapInside(grid, n)) continue;
+            flux += std::min(k, conductivity(m)) * (heat[index(grid, n)] - t);
+        }
+        next[index(grid, c)] = t + flux;
+    }
+}
+
+void ReferenceRules::updateCells(Grid& grid)
+{
+    CellBuffer& next = grid.getNextBuffer();
+    const int size = grid.getSize();
+    const glm::ivec3 slides[4] = {{1, -1, 0}, {-1, -1, 0}, {0, -1, 1}, {0, -1, -1}};
+
+    // Every read is of the cells as they stood, every write to the next buffer, later writes winning
+    for (int z = 0; z < size; ++z)
+    for (int y = size - 1; y >= 0; --y)
+    for (int x = 0; x < size; ++x)
+    {
+        const glm::ivec3 c(x, y, z);
+        const Material m = get(grid, c);
+        if (m == Material::SAND) {
+            // Fall straight down, or else try the one slide this cell and tick pick
+            const glm::ivec3 down(x, y - 1, z);
+            if (get(grid, down) == Material::EMPTY) {
+                move(grid, c, down);
+                continue;
+            }
+            const glm::ivec3 slide = c + slides[slideDirection(seed, tick, x, y, z)];
+            if (get(grid, slide) == Material::EMPTY) move(grid, c, slide);
+        } else if (m == Material::GOL || m == Material::EMPTY) {
+            int count = 0;
+            for (int dz = -1; dz <= 1; ++dz)
+            for (int dy = -1; dy <= 1; ++dy)
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                if (dx || dy || dz) count += get(grid, c + glm::ivec3(dx, dy, dz)) == Material::GOL;
+            }
+            if (m == Material::GOL && !(ruleSet.golSurvive >> count & 1)) next.set(index(grid, c), Material::EMPTY);
+            if (m == Material::EMPTY && (ruleSet.golBirth >> count & 1)) next.set(index(grid, c), Material::GOL);
+        }
+    }
+}
+
+void ReferenceRules::move(Grid& grid, const glm::ivec3& from, const glm::ivec3& to)
+{
+    // Sand moving out of an open face is gone, and across a periodic one comes in opposite
+    CellFields& fields = grid.getFields();
+    const int source = index(grid, from);
+    glm::ivec3 target = to;
+    if (wrapInside(grid, target)) {
+        const int i = index(grid, target);
+        grid.getNextBuffer().set(i, Material::SAND);
+        if (fields.has(CellField::VELOCITY_X)) {
+            fields.next<CellField::VELOCITY_X>()[i] = (int8_t)(to.x - from.x);
+            fields.next<CellField::VELOCITY_Y>()[i] = (int8_t)(to.y - from.y);
+            fields.next<CellField::VELOCITY_Z>()[i] = (int8_t)(to.z - from.z);
+        }
+        if (fields.has(CellField::TEMPERATURE)) {
+            auto& heat = fields.next<CellField::TEMPERATURE>();
+            std::swap(heat[i], heat[source]);
+        }
+        if (fields.has(CellField::AGE)) fields.next<CellField::AGE>()[i] = 0;
+    }
+    grid.getNextBuffer().set(source, Material::EMPTY);
+}
+
+void ReferenceRules::flow(Grid& grid)
+{
+    // Each phase pairs every cell whose coordinate along one axis has a given parity with the next cell along it
+    const int size = grid.getSize();
+    const int axes[6] = {1, 1, 0, 0, 2, 2};
+    for (int phase = 0; phase < 6; ++phase) {
+        const int axis = axes[phase];
+        const int parity = phase & 1;
+        for (int z = 0; z < size; ++z)
+        for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x)
+        {
+            const glm::ivec3 c(x, y, z);
+            if ((c[axis] & 1) != parity) continue;
+            glm::ivec3 n = c;
+            ++n[axis];
+            if (wrapInside(grid, n)) flowPair(grid, c, n, axis == 1);
+        }
+    }
+}
+
+void ReferenceRules::flowPair(Grid& grid, const glm::ivec3& a, const glm::ivec3& b, bool vertical)
+{
+    CellBuffer& cells = grid.getNextBuffer();
+    auto& mass = grid.getMassBuffer();
+    const int i = index(grid, a);
+    const int j = index(grid, b);
+    auto open = [](Material m) { return m == Material::EMPTY || m == Material::WATER; };
+    if (!open(cells[i]) || !open(cells[j])) return;
+
+    // The lower cell of a vertical pair takes what it holds settled, a lateral pair splits evenly
+    const int massA = mass[i];
+    const int massB = mass[j];
+    const int total = massA + massB;
+    int na = massA;
+    if (vertical) {
+        na = stableBottom(total);
+    } else if (std::abs(massA - massB) > MIN_FLOW) {
+        na = (massA > massB) ? total - total / 2 : total / 2;
+    }
+    if (na == massA) return;
+
+    const int nb = total - na;
+    mass[i] = (uint8_t)na;
+    mass[j] = (uint8_t)nb;
+    cells.set(i, na > 0 ? Material::WATER : Material::EMPTY);
+    cells.set(j, nb > 0 ? Material::WATER : Material::EMPTY);
+
+    // The water trades places with as much of the other cell, taking its heat along
+    CellFields& fields = grid.getFields();
+    if (fields.has(CellField::TEMPERATURE)) {
+        auto& heat = fields.next<CellField::TEMPERATURE>();
+        const float share = std::min((float)std::abs(massA - na) / Grid::FULL_MASS, 1.0f);
+        const float traded = (heat[j] - heat[i]) * share;
+        heat[i] += traded;
+        heat[j] -= traded;
+    }
+}
+
+void ReferenceRules::drain(Grid& grid)
+{
+    // A cell on an open face flows into an empty cell beyond it. Nothing leaves through the top
+    CellBuffer& cells = grid.getNextBuffer();
+    auto& mass = grid.getMassBuffer();
+    const int size = grid.getSize();
+    for (int axis = 0; axis < 3; ++axis) {
+        if (grid.getBoundary(axis) != Boundary::OPEN) continue;
+        for (int z = 0; z < size; ++z)
+        for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x)
+        {
+            const glm::ivec3 c(x, y, z);
+            const bool low = c[axis] == 0;
+            const bool high = c[axis] == size - 1 && axis != 1;
+            if (!low && !high) continue;
+
+            const int i = index(grid, c);
+            const int a = mass[i];
+            if (a == 0 || cells[i] != Material::WATER) continue;
+
+            // Below the floor the empty cell is the lower of the pair, beside a side face it levels with it
+            int na = a;
+            if (axis == 1) {
+                na = a - stableBottom(a);
+            } else if (a > MIN_FLOW) {
+                na = a - a / 2;
+            }
+            if (na == a) continue;
+            mass[i] = (uint8_t)na;
+            cells.set(i, na > 0 ? Material::WATER : Material::EMPTY);
+        }
+    }
+}
+
+void ReferenceRules::settleFields(Grid& grid)
+{
+    CellFields& fields = grid.getFields();
+    const CellBuffer& before = grid.getCurrentBuffer();
+    const CellBuffer& after = grid.getNextBuffer();
+    for (size_t i = 0; i < after.size(); ++i) {
+        if (fields.has(CellField::AGE) && (after[i] == Material::EMPTY || after[i] != before[i])) {
+            fields.next<CellField::AGE>()[i] = 0;
+        }
+        if (fields.has(CellField::VELOCITY_X) && after[i] != Material::SAND) {
+            fields.next<CellField::VELOCITY_X>()[i] = 0;
+            fields.next<CellField::VELOCITY_Y>()[i] = 0;
+            fields.next<CellField::VELOCITY_Z>()[i] = 0;
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "../sim/Rules.hpp"
+#include <cstdint>
+#include <glm/glm.hpp>
+
+/// \brief The rules written out as plainly as possible, as the reference Rules::update is checked against
+/// Every cell is visited every tick and every neighbour read through Grid::get, water flows a pair at a time,
+/// and nothing is skipped, cached, packed or replayed. Only whole grids, not slabs
+class ReferenceRules
+{
+public:
+    /// \param ruleSet Game of Life rules
+    /// \param seed Seed of the sand slides, as given to Rules
+    ReferenceRules(const RuleSet& ruleSet, uint32_t seed);
+
+    /// \brief Advance a grid by one tick
+    void update(Grid& grid);
+
+private:
+    RuleSet ruleSet;
+    uint32_t seed;
+    uint64_t tick;
+
+    // Conduct heat across every face between cells as they stand
+    static void conduct(Grid& grid);
+
+    // Move sand and step the Game of Life, cell by cell in z, then descending y, then x order
+    void updateCells(Grid& grid);
+
+    // Move a grain of sand into the next buffer, with its heat, velocity and a fresh age
+    static void move(Grid& grid, const glm::ivec3& from, const glm::ivec3& to);
+
+    // Level water over the six pairing phases, then drain it out of open faces
+    static void flow(Grid& grid);
+    static void flowPair(Grid& grid, const glm::ivec3& a, const glm::ivec3& b, bool vertical);
+    static void drain(Grid& grid);
+
+    // Restart the age of cells that changed and stop sand a birth replaced
+    static void settleFields(Grid& grid);
+};
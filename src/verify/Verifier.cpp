@@ -0,0 +1,247 @@
+#include "Verifier.hpp"
+#include "ReferenceRules.hpp"
+#include "../sim/Decomposition.hpp"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+
+namespace {
+    // One fill of a random case
+    struct Primitive
+    {
+        enum class Type { BOX, SPHERE, NOISE } type;
+        Material material;
+        glm::ivec3 lo, hi;                  // Box and noise bounds
+        glm::vec3 center;
+        float radius;
+        float probability;
+        uint32_t seed;
+    };
+
+    // One box of a random case's starting heat
+    struct Heat
+    {
+        glm::ivec3 lo, hi;
+        float degrees;
+    };
+
+    // Fills are clipped to the grid's slab as Scene::fillSlab does, and noise hashes the full-grid position,
+    // so slabs agree with the whole grid
+    void apply(const Primitive& p, Grid& grid)
+    {
+        const int far = std::numeric_limits<int>::max();
+        const glm::ivec3 clipLo(0, 0, grid.getZOrigin());
+        const glm::ivec3 clipHi(far, far, grid.getZOrigin() + grid.getDepth());
+        switch (p.type) {
+            case Primitive::Type::BOX:
+                grid.fillBox(p.lo, p.hi, p.material, clipLo, clipHi);
+                break;
+            case Primitive::Type::SPHERE:
+                grid.fillSphere(p.center, p.radius, p.material, clipLo, clipHi);
+                break;
+            case Primitive::Type::NOISE:
+                grid.fillNoise(p.lo, p.hi, p.material, p.probability, p.seed, clipLo, clipHi);
+                break;
+        }
+    }
+
+    // Write the differing values of one field, counting them and listing the first few
+    template <typename T>
+    void compareField(CellField field, const std::vector<T>& expected, const std::vector<T>& actual, int size,
+                      VerifyResult& result)
+    {
+        for (size_t i = 0; i < expected.size(); ++i) {
+            T value = actual.empty() ? T(0) : actual[i];
+            if (expected[i] == value) continue;
+            ++result.differingValues;
+            if ((int)result.fieldMismatches.size() < Verifier::MAX_REPORTED) {
+                glm::ivec3 position((int)(i % size), (int)(i / size % size), (int)(i / ((size_t)size * size)));
+                result.fieldMismatches.push_back({position, field, (double)expected[i], (double)value});
+            }
+        }
+    }
+}
+
+Verifier::Verifier(CellStorage storage, Transport* transport) : storage(storage), transport(transport) {}
+
+bool Verifier::run(const VerifyCase& c, int ticks, VerifyResult& result)
+{
+    result = VerifyResult{0, -1, 0, {}, 0, {}};
+
+    // Every slab needs at least one layer of bricks
+    const int size = Grid::roundSize(c.size);
+    const int processes = transport ? transport->getSize() : 1;
+    if (processes > size / Grid::BRICK) {
+        std::cerr << c.name << ": a grid of size " << size << " splits into at most " << size / Grid::BRICK
+                  << " processes" << std::endl;
+        return false;
+    }
+
+    std::unique_ptr<Decomposition> decomposition;
+    std::unique_ptr<Grid> backend;
+    std::unique_ptr<Grid> full;
+    if (transport) {
+        decomposition = std::make_unique<Decomposition>(*transport, size, c.boundaries[2]);
+        backend = std::make_unique<Grid>(size, c.boundaries, storage, decomposition->getBegin(),
+                                         decomposition->getEnd());
+        full = std::make_unique<Grid>(size, c.boundaries, storage);
+    } else {
+        backend = std::make_unique<Grid>(size, c.boundaries, storage);
+    }
+    c.fill(*backend);
+    Rules rules(c.ruleSet, c.seed);
+    rules.setDecomposition(decomposition.get());
+
+    const bool comparing = !transport || transport->getRank() == 0;
+    std::unique_ptr<Grid> reference;
+    ReferenceRules referenceRules(c.ruleSet, c.seed);
+    if (comparing) {
+        reference = std::make_unique<Grid>(size, c.boundaries);
+        c.fill(*reference);
+    }
+
+    // Tick 0 compares the starting grids, so a fill that differs between storages shows up as such
+    for (int tick = 0; ; ++tick) {
+        if (tick > 0) {
+            rules.update(*backend);
+            if (comparing) referenceRules.update(*reference);
+        }
+
+        const Grid* compared = backend.get();
+        if (decomposition) {
+            if (!decomposition->gather(*backend, *full)) return false;
+            compared = full.get();
+        }
+
+        bool more = true;
+        if (comparing) {
+            result.ticksRun = tick;
+            if (!compare(*reference, *compared, result)) {
+                result.divergedTick = tick;
+                more = false;
+            }
+            more = more && tick < ticks;
+        }
+        if (transport && !broadcast(more)) return false;
+        if (!more) break;
+    }
+    return true;
+}
+
+VerifyCase Verifier::randomCase(uint32_t seed, int minSize)
+{
+    std::mt19937 rng(seed);
+    auto uniform = [&](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+    auto real = [&](float lo, float hi) { return std::uniform_real_distribution<float>(lo, hi)(rng); };
+
+    VerifyCase c;
+    c.name = "fuzz " + std::to_string(seed);
+    c.size = std::max(uniform(2, 5) * Grid::BRICK, Grid::roundSize(minSize));
+    for (int axis = 0; axis < 3; ++axis) {
+        c.boundaries[axis] = (Boundary)uniform(0, 2);
+    }
+    c.seed = rng();
+
+    // Survive and birth counts near the defaults, so life neither always dies out nor always fills the grid
+    int survive = uniform(2, 7);
+    int surviveEnd = survive + uniform(0, 3);
+    int birth = uniform(4, 7);
+    int birthEnd = birth + uniform(0, 1);
+    c.ruleSet.golSurvive = 0;
+    c.ruleSet.golBirth = 0;
+    for (int n = survive; n <= surviveEnd; ++n) c.ruleSet.golSurvive |= 1u << n;
+    for (int n = birth; n <= birthEnd; ++n) c.ruleSet.golBirth |= 1u << n;
+
+    // Later fills overwrite earlier ones, empty ones carving holes
+    const Material materials[] = {Material::SAND, Material::WATER, Material::GOL, Material::WALL, Material::EMPTY};
+    std::vector<Primitive> primitives(uniform(2, 8));
+    for (Primitive& p : primitives) {
+        p.type = (Primitive::Type)uniform(0, 2);
+        p.material = materials[uniform(0, 4)];
+        p.lo = glm::ivec3(uniform(0, c.size - 1), uniform(0, c.size - 1), uniform(0, c.size - 1));
+        p.hi = glm::min(p.lo + glm::ivec3(uniform(1, c.size / 2), uniform(1, c.size / 2), uniform(1, c.size / 2)),
+                        glm::ivec3(c.size));
+        p.center = glm::vec3(real(0.0f, (float)c.size), real(0.0f, (float)c.size), real(0.0f, (float)c.size));
+        p.radius = real(1.0f, c.size / 4.0f);
+        p.probability = real(0.05f, 0.6f);
+        p.seed = rng();
+    }
+    // Half the cases also track fields, heat starting in a few hot or cold boxes
+    const bool tracksTemperature = uniform(0, 1);
+    const bool tracksVelocity = uniform(0, 1);
+    const bool tracksAge = uniform(0, 1);
+    std::vector<Heat> heat(tracksTemperature ? uniform(1, 3) : 0);
+    for (Heat& h : heat) {
+        h.lo = glm::ivec3(uniform(0, c.size - 1), uniform(0, c.size - 1), uniform(0, c.size - 1));
+        h.hi = glm::min(h.lo + glm::ivec3(uniform(1, c.size / 2), uniform(1, c.size / 2), uniform(1, c.size / 2)),
+                        glm::ivec3(c.size));
+        h.degrees = real(-50.0f, 150.0f);
+    }
+    c.fill = [primitives, heat, tracksTemperature, tracksVelocity, tracksAge](Grid& grid) {
+        for (const Primitive& p : primitives) apply(p, grid);
+        CellFields& fields = grid.getFields();
+        if (tracksTemperature) fields.enable(CellField::TEMPERATURE);
+        if (tracksVelocity) {
+            fields.enable(CellField::VELOCITY_X);
+            fields.enable(CellField::VELOCITY_Y);
+            fields.enable(CellField::VELOCITY_Z);
+        }
+        if (tracksAge) fields.enable(CellField::AGE);
+        for (const Heat& h : heat) grid.fillTemperature(h.lo, h.hi, h.degrees);
+    };
+
+    const char* names[] = {"wall", "periodic", "open"};
+    c.name += " (size " + std::to_string(c.size) + ", " + names[(int)c.boundaries[0]] + "/"
+            + names[(int)c.boundaries[1]] + "/" + names[(int)c.boundaries[2]] + ", " + c.ruleSet.toString()
+            + (tracksTemperature ? ", temperature" : "") + (tracksVelocity ? ", velocity" : "")
+            + (tracksAge ? ", age" : "") + ")";
+    return c;
+}
+
+bool Verifier::compare(const Grid& reference, const Grid& backend, VerifyResult& result)
+{
+    const int size = reference.getSize();
+    result.differingValues = 0;
+    result.fieldMismatches.clear();
+    const CellFields& actualFields = backend.getFields();
+    reference.getFields().forEach([&](auto field, const auto& expected) {
+        compareField(field, expected, actualFields.current<decltype(field)::value>(), size, result);
+    });
+    if (reference.fingerprint() == backend.fingerprint()) {
+        result.differing = 0;
+        result.mismatches.clear();
+        return result.differingValues == 0;
+    }
+
+    const CellBuffer& expected = reference.getCurrentBuffer();
+    const CellBuffer& actual = backend.getCurrentBuffer();
+    const std::vector<uint8_t>& expectedMass = reference.getMassBuffer();
+    const std::vector<uint8_t>& actualMass = backend.getMassBuffer();
+    result.differing = 0;
+    result.mismatches.clear();
+    for (size_t i = 0; i < expected.size(); ++i) {
+        if (expected[i] == actual[i] && expectedMass[i] == actualMass[i]) continue;
+        ++result.differing;
+        if ((int)result.mismatches.size() < MAX_REPORTED) {
+            glm::ivec3 position((int)(i % size), (int)(i / size % size), (int)(i / ((size_t)size * size)));
+            result.mismatches.push_back({position, expected[i], actual[i], expectedMass[i], actualMass[i]});
+        }
+    }
+    return result.differing == 0 && result.differingValues == 0;
+}
+
+bool Verifier::broadcast(bool& flag)
+{
+    uint8_t byte = flag ? 1 : 0;
+    if (transport->getRank() == 0) {
+        for (int r = 1; r < transport->getSize(); ++r) {
+            if (!transport->exchange(r, &byte, 1, -1, received)) return false;
+        }
+        return true;
+    }
+    if (!transport->exchange(-1, nullptr, 0, 0, received) || received.size() != 1) return false;
+    flag = received[0] != 0;
+    return true;
+}
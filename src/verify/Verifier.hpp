@@ -0,0 +1,90 @@
+#pragma once
+
+#include "../sim/Rules.hpp"
+#include "../sim/Transport.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+/// \brief A starting grid and rules, run by the reference and the backend alike
+struct VerifyCase
+{
+    std::string name;
+    int size = Grid::DEFAULT_SIZE;
+    Boundaries boundaries = {Boundary::WALL, Boundary::WALL, Boundary::WALL};
+    RuleSet ruleSet;
+    uint32_t seed = 42;
+    std::function<void(Grid&)> fill;        // Fills a fresh grid of the case, or a slab of one, with the starting cells
+};
+
+/// \brief One cell the backend disagrees with the reference on
+struct CellMismatch
+{
+    glm::ivec3 position;
+    Material expected;
+    Material actual;
+    uint8_t expectedMass;
+    uint8_t actualMass;
+};
+
+/// \brief One value of a per-cell field the backend disagrees with the reference on
+struct FieldMismatch
+{
+    glm::ivec3 position;
+    CellField field;
+    double expected;
+    double actual;
+};
+
+/// \brief Outcome of one case
+struct VerifyResult
+{
+    int ticksRun;
+    int divergedTick;                       // First tick after which the grids differ, 0 for the starting grids, -1 if never
+    size_t differing;                       // Cells differing in material or mass after that tick
+    std::vector<CellMismatch> mismatches;   // The first of them in index order, at most Verifier::MAX_REPORTED
+    size_t differingValues;                 // Values of the reference's fields differing after that tick
+    std::vector<FieldMismatch> fieldMismatches; // The first of them by field then index, at most Verifier::MAX_REPORTED
+};
+
+class Verifier
+{
+public:
+    static constexpr int MAX_REPORTED = 8;  // Differing cells listed per divergence
+
+    /// \brief Runs ReferenceRules next to Rules::update and compares their grids every tick
+    /// The reference is a separate, plain statement of the rules on byte cells in one process, so any
+    /// backend, byte cells in one process included, is checked against code it shares none of its kernels with
+    /// \param storage Cell storage of the backend
+    /// \param transport Processes the backend splits the grid's z between, null for one process
+    Verifier(CellStorage storage, Transport* transport = nullptr);
+
+    /// \brief Run a case until the grids first differ or the ticks run out
+    /// With several processes every rank runs the same cases in step, and only rank 0 compares
+    /// \param c Case to run
+    /// \param ticks Ticks to run
+    /// \param result Filled on rank 0
+    /// \return False if the case could not be run
+    bool run(const VerifyCase& c, int ticks, VerifyResult& result);
+
+    /// \brief Make a random case of boxes, spheres and noise of every material, with random boundaries and rules,
+    /// and for some cases per-cell fields with hot boxes
+    /// \param seed Seed the whole case derives from, so it can be run again
+    /// \param minSize Smallest grid size to pick
+    static VerifyCase randomCase(uint32_t seed, int minSize = 16);
+
+private:
+    CellStorage storage;
+    Transport* transport;
+    std::vector<uint8_t> received;
+
+    // Compare the backend's cells, mass and fields with the reference's, listing the first differences.
+    // A field the backend never allocated reads as zero
+    static bool compare(const Grid& reference, const Grid& backend, VerifyResult& result);
+
+    // Send rank 0's decision to the other ranks
+    bool broadcast(bool& flag);
+};
@@ -0,0 +1,121 @@
+#include "Verifier.hpp"
+#include "../dist/SocketTransport.hpp"
+#include "../sim/Scene.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+    void printUsage()
+    {
+        std::cerr << "Usage: automata_verify [scene...] [options]\n"
+                     "  --ticks N              Ticks to run each case (200)\n"
+                     "  --fuzz N               Random cases to run, 50 when no scene is given\n"
+                     "  --fuzz-seed N          Seed of the first random case, counting up from there (1)\n"
+                     "  --packed               Backend stores cells two to a byte\n"
+                     "  --processes N          Backend splits the grid's z between processes (1)\n";
+    }
+
+    void printResult(const VerifyCase& c, const VerifyResult& result)
+    {
+        if (result.divergedTick < 0) {
+            std::printf("%s: matches over %d ticks\n", c.name.c_str(), result.ticksRun);
+            return;
+        }
+        std::printf("%s: diverged at tick %d, %zu cells and %zu field values differ\n", c.name.c_str(),
+                    result.divergedTick, result.differing, result.differingValues);
+        for (const CellMismatch& m : result.mismatches) {
+            std::printf("  (%d, %d, %d): expected %s mass %d, got %s mass %d\n", m.position.x, m.position.y,
+                        m.position.z, getMaterialName(m.expected), m.expectedMass, getMaterialName(m.actual),
+                        m.actualMass);
+        }
+        const char* fieldNames[] = {"temperature", "velocity x", "velocity y", "velocity z", "age"};
+        for (const FieldMismatch& m : result.fieldMismatches) {
+            std::printf("  (%d, %d, %d): expected %s %g, got %g\n", m.position.x, m.position.y, m.position.z,
+                        fieldNames[(int)m.field], m.expected, m.actual);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> scenePaths;
+    int ticks = 200;
+    int fuzz = -1;
+    uint32_t fuzzSeed = 1;
+    int processes = 1;
+    CellStorage storage = CellStorage::BYTE;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        bool ok = true;
+        if (arg == "--ticks" && hasValue) {
+            ticks = std::atoi(argv[++i]);
+            ok = ticks >= 0;
+        } else if (arg == "--fuzz" && hasValue) {
+            fuzz = std::atoi(argv[++i]);
+            ok = fuzz >= 0;
+        } else if (arg == "--fuzz-seed" && hasValue) {
+            fuzzSeed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--packed") {
+            storage = CellStorage::PACKED;
+        } else if (arg == "--processes" && hasValue) {
+            processes = std::atoi(argv[++i]);
+            ok = processes > 0;
+        } else if (arg[0] != '-') {
+            scenePaths.push_back(arg);
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            std::cerr << "Invalid argument: " << arg << std::endl;
+            printUsage();
+            return 1;
+        }
+    }
+    if (fuzz < 0) fuzz = scenePaths.empty() ? 50 : 0;
+
+    // Scenes load before any processes fork, so every rank runs the same cases
+    std::vector<VerifyCase> cases;
+    for (const std::string& path : scenePaths) {
+        auto scene = std::make_shared<Scene>();
+        if (!scene->load(path)) return 1;
+        VerifyCase c;
+        c.name = path;
+        c.size = scene->getSize();
+        c.boundaries = scene->getBoundaries();
+        c.ruleSet = scene->getRuleSet();
+        c.seed = scene->getSeed();
+        c.fill = [scene](Grid& grid) { scene->fill(grid); };
+        cases.push_back(c);
+    }
+    for (int i = 0; i < fuzz; ++i) {
+        cases.push_back(Verifier::randomCase(fuzzSeed + (uint32_t)i, processes * Grid::BRICK));
+    }
+
+    std::unique_ptr<SocketTransport> transport;
+    if (processes > 1) {
+        transport = SocketTransport::spawn(processes);
+        if (!transport) return 1;
+    }
+    const bool reporting = !transport || transport->getRank() == 0;
+
+    Verifier verifier(storage, transport.get());
+    int diverged = 0;
+    for (const VerifyCase& c : cases) {
+        VerifyResult result;
+        if (!verifier.run(c, ticks, result)) return 1;
+        if (!reporting) continue;
+        printResult(c, result);
+        if (result.divergedTick >= 0) ++diverged;
+    }
+
+    if (reporting) {
+        std::printf("%zu of %zu cases match the reference\n", cases.size() - diverged, cases.size());
+    }
+    return diverged ? 1 : 0;
+}